@@ -2,8 +2,13 @@
 #define _CT_STL_ALLOC_H
 
 #include "stdlib.h"
+#include "instrument.h"
 #include "types.h"
 
+#ifndef CACHE_LINE
+#define CACHE_LINE 64
+#endif
+
 static const u64 mem_round(const u64 n, const u64 alignment)
 {
 	double num = (n / alignment);
@@ -16,27 +21,27 @@ typedef struct {
 	const u64 size;
 } Blk;
 
-Blk alloc_blk(const register u64 _size)
+CT_API Blk alloc_blk(const register u64 _size)
 {
 	Blk blk = {
-		.mem = malloc(_size),
+		.mem = CT_MALLOC(_size),
 		.size = _size
 	};
 	return blk;
 }
 
-Blk calloc_blk(const register u64 _amount, const register u64 _size)
+CT_API Blk calloc_blk(const register u64 _amount, const register u64 _size)
 {
 	Blk blk = {
-		.mem = calloc(_amount, _size),
+		.mem = CT_CALLOC(_amount, _size),
 		.size = (_amount*_size)
 	};
 	return blk;
 }
 
-void free_blk(const Blk* restrict _blk)
+CT_API void free_blk(const Blk* restrict _blk)
 {
-	free(_blk->mem);
+	CT_FREE(_blk->mem);
 	return;
 }
 
@@ -0,0 +1,160 @@
+#ifndef _CT_STL_BENCH_H
+#define _CT_STL_BENCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../types.h"
+
+/*
+ | Minimal benchmark harness shared by the bench_* binaries
+ | Every case is timed sample by sample so latency percentiles come out alongside the mean,
+ | results are printed as a table on stderr and as JSON on stdout for regression tracking
+*/
+
+#define BENCH_MAX_SAMPLES 4096
+#define BENCH_MIN_SAMPLE_NS 2000
+
+// the case mutates its input, so setup runs before every sample and each sample is one call
+#define BENCH_PER_SAMPLE (1 << 0)
+// the case reads a buffer it does not own, so it is also run at every misalignment
+#define BENCH_ALIGN (1 << 1)
+
+typedef struct Bench_case {
+	const char* name;
+	const char* impl;
+	void (*setup)(void*);
+	void (*run)(void*);
+	void (*teardown)(void*);
+	u32 flags;
+} Bench_case;
+
+typedef struct Bench_result {
+	d64 samples[BENCH_MAX_SAMPLES];
+	u64 n_samples;
+	u64 reps;
+} Bench_result;
+
+static u64 BENCH_SAMPLES = 200;
+static d64 BENCH_TIMER_NS = 0;
+static bool BENCH_FIRST_JSON = true;
+
+static inline u64 bench_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (u64)now.tv_sec * 1000000000UL + (u64)now.tv_nsec;
+}
+
+static int bench_cmp_d64(const void* _a, const void* _b)
+{
+	const d64 a = *(const d64*)_a;
+	const d64 b = *(const d64*)_b;
+	return (a > b) - (a < b);
+}
+
+static void bench_init(int _argc, char** _argv)
+/*
+ | Reads BENCH_SAMPLES from the environment and measures the cost of reading the clock
+*/
+{
+	(void)_argc;
+	(void)_argv;
+	const char* samples = getenv("BENCH_SAMPLES");
+	if (samples) BENCH_SAMPLES = strtoul(samples, NULL, 10);
+	if (BENCH_SAMPLES == 0) BENCH_SAMPLES = 1;
+	if (BENCH_SAMPLES > BENCH_MAX_SAMPLES) BENCH_SAMPLES = BENCH_MAX_SAMPLES;
+
+	d64 best = 1e18;
+	for ( int idx = 0; idx < 1000; ++idx ) {
+		const u64 start = bench_now();
+		const u64 stop = bench_now();
+		if ((d64)(stop - start) < best) best = (d64)(stop - start);
+	}
+	BENCH_TIMER_NS = best;
+
+	printf("{\n\"timer_ns\": %.1f,\n\"benchmarks\": [\n", BENCH_TIMER_NS);
+	fprintf(stderr, "%-28s %-14s %9s %5s %12s %12s %12s %12s\n",
+			"case", "impl", "size", "align", "p50 ns", "p90 ns", "p99 ns", "MB/s");
+}
+
+static void bench_finish(void)
+{
+	printf("\n]\n}\n");
+}
+
+static void bench_run(const Bench_case* restrict _case, void* _ctx, Bench_result* restrict _result)
+/*
+ | Collects BENCH_SAMPLES samples of _case, in ns per call with the clock overhead removed
+*/
+{
+	u64 reps = 1;
+	if (!(_case->flags & BENCH_PER_SAMPLE)) {
+		// grow the batch until one sample is long enough for the clock to resolve it
+		_case->setup(_ctx);
+		for ( ;; ) {
+			const u64 start = bench_now();
+			for ( u64 rep = 0; rep < reps; ++rep ) _case->run(_ctx);
+			if (bench_now() - start >= BENCH_MIN_SAMPLE_NS || reps >= (1UL << 20)) break;
+			reps <<= 1;
+		}
+	}
+
+	for ( u64 idx = 0; idx < BENCH_SAMPLES; ++idx ) {
+		if (_case->flags & BENCH_PER_SAMPLE) _case->setup(_ctx);
+
+		const u64 start = bench_now();
+		for ( u64 rep = 0; rep < reps; ++rep ) _case->run(_ctx);
+		const u64 stop = bench_now();
+
+		const d64 ns = ((d64)(stop - start) - BENCH_TIMER_NS) / (d64)reps;
+		_result->samples[idx] = (ns > 0) ? ns : 0;
+
+		if (_case->flags & BENCH_PER_SAMPLE) _case->teardown(_ctx);
+	}
+	if (!(_case->flags & BENCH_PER_SAMPLE)) _case->teardown(_ctx);
+
+	_result->n_samples = BENCH_SAMPLES;
+	_result->reps = reps;
+}
+
+static void bench_report(const Bench_case* restrict _case, Bench_result* restrict _result, const u64 _size, const u64 _align)
+{
+	qsort(_result->samples, _result->n_samples, sizeof(d64), bench_cmp_d64);
+
+	const u64 n = _result->n_samples;
+	d64 mean = 0;
+	for ( u64 idx = 0; idx < n; ++idx ) mean += _result->samples[idx];
+	mean /= (d64)n;
+
+	const d64 p50 = _result->samples[n / 2];
+	const d64 p90 = _result->samples[(n * 90) / 100];
+	const d64 p99 = _result->samples[(n * 99) / 100];
+	const d64 mb_s = (p50 > 0) ? ((d64)_size * 1e3) / p50 : 0;
+
+	fprintf(stderr, "%-28s %-14s %9lu %5lu %12.1f %12.1f %12.1f %12.1f\n",
+			_case->name, _case->impl, _size, _align, p50, p90, p99, mb_s);
+
+	printf("%s{\"name\": \"%s\", \"impl\": \"%s\", \"size\": %lu, \"align\": %lu, \"samples\": %lu, \"reps\": %lu, "
+			"\"min_ns\": %.2f, \"mean_ns\": %.2f, \"p50_ns\": %.2f, \"p90_ns\": %.2f, \"p99_ns\": %.2f, \"max_ns\": %.2f, \"mb_per_s\": %.2f}",
+			BENCH_FIRST_JSON ? "" : ",\n",
+			_case->name, _case->impl, _size, _align, n, _result->reps,
+			_result->samples[0], mean, p50, p90, p99, _result->samples[n - 1], mb_s);
+	BENCH_FIRST_JSON = false;
+}
+
+static const bool bench_selected(const Bench_case* restrict _case, const int _argc, char** _argv)
+/*
+ | With no arguments every case runs, otherwise only those whose name contains one of them
+*/
+{
+	if (_argc < 2) return true;
+	for ( int idx = 1; idx < _argc; ++idx )
+		if (strstr(_case->name, _argv[idx])) return true;
+	return false;
+}
+
+#endif // End _CT_STL_BENCH_H
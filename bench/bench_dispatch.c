@@ -0,0 +1,159 @@
+/*
+ | Measures what the String / SS dispatch tables cost on small-string hot loops
+ |
+ | Every case runs twice: once through the const tables, the way callers write it, and once
+ | through a volatile copy of the same table, which forces a real indirect call per operation
+ | The Makefile builds this file as bench_dispatch and, with -DCT_STATIC_DISPATCH, as
+ | bench_dispatch_static, compare the "table" rows of the two binaries to see the gain
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../string.h"
+#include "../stack_string.h"
+
+#define N_STRINGS 1024
+
+#ifdef CT_STATIC_DISPATCH
+#define DISPATCH_IMPL "static"
+#else
+#define DISPATCH_IMPL "extern"
+#endif
+
+typedef struct Bench_ctx {
+	SS_t ss[N_STRINGS];
+	String_t str[N_STRINGS];
+	char text[N_STRINGS][24];
+	volatile u64 sink;
+} Bench_ctx;
+
+// a copy the compiler cannot see through, standing in for a table it cannot fold
+static volatile struct String_funcs STRING_INDIRECT;
+static volatile StackString SS_INDIRECT;
+
+static void setup_none(void* _ctx) { (void)_ctx; }
+
+static void setup_append(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) {
+		ctx->str[idx].len = 0;
+		ctx->str[idx].data[0] = '\0';
+	}
+}
+
+#define CTX ((Bench_ctx*)_ctx)
+#define RUN(_name) static void _name(void* _ctx)
+
+RUN(run_ss_len)
+{
+	u64 sum = 0;
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) sum += SS.len(&CTX->ss[idx]);
+	CTX->sink = sum;
+}
+
+RUN(run_ss_len_indirect)
+{
+	u64 sum = 0;
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) sum += SS_INDIRECT.len(&CTX->ss[idx]);
+	CTX->sink = sum;
+}
+
+RUN(run_ss_end)
+{
+	u64 sum = 0;
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) sum += (u64)SS.end(&CTX->ss[idx]);
+	CTX->sink = sum;
+}
+
+RUN(run_ss_end_indirect)
+{
+	u64 sum = 0;
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) sum += (u64)SS_INDIRECT.end(&CTX->ss[idx]);
+	CTX->sink = sum;
+}
+
+RUN(run_str_len)
+{
+	u64 sum = 0;
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) sum += String.len(&CTX->str[idx]);
+	CTX->sink = sum;
+}
+
+RUN(run_str_len_indirect)
+{
+	u64 sum = 0;
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) sum += STRING_INDIRECT.len(&CTX->str[idx]);
+	CTX->sink = sum;
+}
+
+RUN(run_str_cstr)
+{
+	u64 sum = 0;
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) sum += (u64)String.cstr(&CTX->str[idx])[0];
+	CTX->sink = sum;
+}
+
+RUN(run_str_cstr_indirect)
+{
+	u64 sum = 0;
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) sum += (u64)STRING_INDIRECT.cstr(&CTX->str[idx])[0];
+	CTX->sink = sum;
+}
+
+RUN(run_str_append_n)
+{
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) String.append_n(&CTX->str[idx], "ab", 2);
+}
+
+RUN(run_str_append_n_indirect)
+{
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) STRING_INDIRECT.append_n(&CTX->str[idx], "ab", 2);
+}
+
+static const Bench_case CASES[] = {
+	{ "SS.len",				"table",		setup_none,		run_ss_len,					setup_none,	0 },
+	{ "SS.len",				"indirect",		setup_none,		run_ss_len_indirect,		setup_none,	0 },
+	{ "SS.end",				"table",		setup_none,		run_ss_end,					setup_none,	0 },
+	{ "SS.end",				"indirect",		setup_none,		run_ss_end_indirect,		setup_none,	0 },
+	{ "String.len",			"table",		setup_none,		run_str_len,				setup_none,	0 },
+	{ "String.len",			"indirect",		setup_none,		run_str_len_indirect,		setup_none,	0 },
+	{ "String.cstr",		"table",		setup_none,		run_str_cstr,				setup_none,	0 },
+	{ "String.cstr",		"indirect",		setup_none,		run_str_cstr_indirect,		setup_none,	0 },
+	{ "String.append_n",	"table",		setup_append,	run_str_append_n,			setup_none,	BENCH_PER_SAMPLE },
+	{ "String.append_n",	"indirect",		setup_append,	run_str_append_n_indirect,	setup_none,	BENCH_PER_SAMPLE },
+};
+
+static Bench_result RESULT;
+static Bench_ctx CTX_DATA;
+
+int main(int argc, char** argv)
+{
+	memcpy((void*)&STRING_INDIRECT, &String, sizeof(String));
+	memcpy((void*)&SS_INDIRECT, &SS, sizeof(SS));
+
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) {
+		snprintf(CTX_DATA.text[idx], sizeof(CTX_DATA.text[idx]), "str-%lu", idx);
+		CTX_DATA.ss[idx] = SS.owned_from(CTX_DATA.text[idx]).contents;
+
+		// room for a full sample of append_n calls without resizing
+		CTX_DATA.str[idx] = String.owned_from_n("", 0).contents;
+		String.resize(&CTX_DATA.str[idx], 2 * BENCH_MAX_SAMPLES + 1);
+	}
+
+	bench_init(argc, argv);
+	for ( u64 idx = 0; idx < sizeof(CASES) / sizeof(Bench_case); ++idx ) {
+		Bench_case bench = CASES[idx];
+		if (!bench_selected(&bench, argc, argv)) continue;
+		if (strcmp(bench.impl, "table") == 0) bench.impl = DISPATCH_IMPL "/table";
+
+		bench_run(&bench, &CTX_DATA, &RESULT);
+		bench_report(&bench, &RESULT, N_STRINGS, 0);
+	}
+	bench_finish();
+
+	for ( u64 idx = 0; idx < N_STRINGS; ++idx ) String.free_owned(&CTX_DATA.str[idx]);
+	return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ | Number formatting and parsing on String_t against the snprintf / strto* code they replace
+ |
+ | Every sample formats or parses the whole batch, doubles are random bit patterns, so every
+ | exponent shows up, and integers are random magnitudes of 1 to 19 digits
+ | The size column is the number of values and the last column reads as million values per second
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../string.h"
+#include "../number.h"
+
+static const u64 NUM_SIZES[] = { 1024 };
+
+typedef struct Bench_ctx {
+	u64 n;
+
+	d64* f64s;
+	i64* i64s;
+
+	// every value rendered once, NUL separated, for the parsing cases
+	String_t f64_text;
+	String_t i64_text;
+	u64* f64_offs;
+	u64* i64_offs;
+
+	// cleared and refilled by the formatting cases, sized up front so they never grow it
+	String_t out;
+
+	volatile u64 sink;
+} Bench_ctx;
+
+static u64 rand_next(u64* _state)
+{
+	*_state ^= *_state << 13;
+	*_state ^= *_state >> 7;
+	*_state ^= *_state << 17;
+	return *_state;
+}
+
+static void ctx_init(Bench_ctx* restrict _ctx, const u64 _n)
+{
+	memset(_ctx, 0, sizeof(Bench_ctx));
+	_ctx->n = _n;
+	_ctx->f64s = (d64*)malloc(_n * sizeof(d64));
+	_ctx->i64s = (i64*)malloc(_n * sizeof(i64));
+	_ctx->f64_offs = (u64*)malloc(_n * sizeof(u64));
+	_ctx->i64_offs = (u64*)malloc(_n * sizeof(u64));
+	_ctx->f64_text = String.owned_from_n("", 0).contents;
+	_ctx->i64_text = String.owned_from_n("", 0).contents;
+	_ctx->out = String.owned_from_n("", 0).contents;
+	String.resize(&_ctx->out, _n * 32);
+
+	u64 state = 0x9E3779B97F4A7C15UL;
+	for ( u64 idx = 0; idx < _n; ++idx ) {
+		u64 bits;
+		d64 val;
+		do {
+			bits = rand_next(&state);
+			memcpy(&val, &bits, sizeof(d64));
+		} while ( !isfinite(val) );
+		_ctx->f64s[idx] = val;
+
+		const u64 mag = rand_next(&state) >> (rand_next(&state) % 64);
+		_ctx->i64s[idx] = (idx & 1) ? -(i64)(mag >> 1) : (i64)(mag >> 1);
+
+		_ctx->f64_offs[idx] = _ctx->f64_text.len;
+		Num.append_f64(&_ctx->f64_text, val);
+		String.append_n(&_ctx->f64_text, "", 1);
+
+		_ctx->i64_offs[idx] = _ctx->i64_text.len;
+		Num.append_i64(&_ctx->i64_text, _ctx->i64s[idx]);
+		String.append_n(&_ctx->i64_text, "", 1);
+	}
+}
+
+static void ctx_free(Bench_ctx* restrict _ctx)
+{
+	free(_ctx->f64s);
+	free(_ctx->i64s);
+	free(_ctx->f64_offs);
+	free(_ctx->i64_offs);
+	String.free_owned(&_ctx->f64_text);
+	String.free_owned(&_ctx->i64_text);
+	String.free_owned(&_ctx->out);
+}
+
+static void setup_none(void* _ctx) { (void)_ctx; }
+static void teardown_none(void* _ctx) { (void)_ctx; }
+
+#define CTX ((Bench_ctx*)_ctx)
+#define RUN(_name) static void _name(void* _ctx)
+
+RUN(run_append_f64)
+{
+	String.clear(&CTX->out);
+	for ( u64 idx = 0; idx < CTX->n; ++idx ) Num.append_f64(&CTX->out, CTX->f64s[idx]);
+	CTX->sink += CTX->out.len;
+}
+
+RUN(run_append_f64_snprintf)
+{
+	String.clear(&CTX->out);
+	char buf[32];
+	for ( u64 idx = 0; idx < CTX->n; ++idx )
+		String.append_n(&CTX->out, buf, snprintf(buf, sizeof(buf), "%.17g", CTX->f64s[idx]));
+	CTX->sink += CTX->out.len;
+}
+
+RUN(run_append_i64)
+{
+	String.clear(&CTX->out);
+	for ( u64 idx = 0; idx < CTX->n; ++idx ) Num.append_i64(&CTX->out, CTX->i64s[idx]);
+	CTX->sink += CTX->out.len;
+}
+
+RUN(run_append_i64_snprintf)
+{
+	String.clear(&CTX->out);
+	char buf[32];
+	for ( u64 idx = 0; idx < CTX->n; ++idx )
+		String.append_n(&CTX->out, buf, snprintf(buf, sizeof(buf), "%ld", CTX->i64s[idx]));
+	CTX->sink += CTX->out.len;
+}
+
+RUN(run_to_f64)
+{
+	d64 sum = 0;
+	for ( u64 idx = 0; idx < CTX->n; ++idx ) {
+		const char* str = CTX->f64_text.data + CTX->f64_offs[idx];
+		sum += Num.to_f64(str, strlen(str)).contents;
+	}
+	CTX->sink += (u64)(sum != 0);
+}
+
+RUN(run_to_f64_strtod)
+{
+	d64 sum = 0;
+	for ( u64 idx = 0; idx < CTX->n; ++idx ) sum += strtod(CTX->f64_text.data + CTX->f64_offs[idx], NULL);
+	CTX->sink += (u64)(sum != 0);
+}
+
+RUN(run_to_i64)
+{
+	u64 sum = 0;
+	for ( u64 idx = 0; idx < CTX->n; ++idx ) {
+		const char* str = CTX->i64_text.data + CTX->i64_offs[idx];
+		sum += (u64)Num.to_i64(str, strlen(str)).contents;
+	}
+	CTX->sink += sum;
+}
+
+RUN(run_to_i64_strtoll)
+{
+	u64 sum = 0;
+	for ( u64 idx = 0; idx < CTX->n; ++idx ) sum += (u64)strtoll(CTX->i64_text.data + CTX->i64_offs[idx], NULL, 10);
+	CTX->sink += sum;
+}
+
+static const Bench_case NUM_CASES[] = {
+	{ "Num.append_f64",	"ct_stl",			setup_none,	run_append_f64,				teardown_none,	0 },
+	{ "Num.append_f64",	"libc/snprintf",	setup_none,	run_append_f64_snprintf,	teardown_none,	0 },
+	{ "Num.append_i64",	"ct_stl",			setup_none,	run_append_i64,				teardown_none,	0 },
+	{ "Num.append_i64",	"libc/snprintf",	setup_none,	run_append_i64_snprintf,	teardown_none,	0 },
+	{ "Num.to_f64",		"ct_stl",			setup_none,	run_to_f64,					teardown_none,	0 },
+	{ "Num.to_f64",		"libc/strtod",		setup_none,	run_to_f64_strtod,			teardown_none,	0 },
+	{ "Num.to_i64",		"ct_stl",			setup_none,	run_to_i64,					teardown_none,	0 },
+	{ "Num.to_i64",		"libc/strtoll",		setup_none,	run_to_i64_strtoll,			teardown_none,	0 },
+};
+
+static Bench_result RESULT;
+
+int main(int argc, char** argv)
+{
+	bench_init(argc, argv);
+	Bench_ctx ctx;
+
+	for ( u64 size = 0; size < sizeof(NUM_SIZES) / sizeof(u64); ++size ) {
+		ctx_init(&ctx, NUM_SIZES[size]);
+		for ( u64 idx = 0; idx < sizeof(NUM_CASES) / sizeof(Bench_case); ++idx ) {
+			const Bench_case* bench = &NUM_CASES[idx];
+			if (!bench_selected(bench, argc, argv)) continue;
+
+			bench_run(bench, &ctx, &RESULT);
+			bench_report(bench, &RESULT, NUM_SIZES[size], 0);
+		}
+		ctx_free(&ctx);
+	}
+	bench_finish();
+
+	return 0;
+}
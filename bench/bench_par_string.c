@@ -0,0 +1,144 @@
+/*
+ | Scaling of the ParString table over the thread pool
+ |
+ | Every case runs once per pool size, the impl column reads pool/<threads>t with the calling
+ | thread counted, so pool/1t is the serial path and the baseline for the other rows
+ | Pool sizes go up to the online cpu count and always include 2 so the parallel paths are
+ | exercised everywhere, on a single core machine the rows above 1t only show the overhead
+ | The threshold is dropped to 0 so the smaller sizes show where splitting starts to pay off
+ | count_periodic searches a text of nothing but 'a' for "aaa", every match overlaps the next
+ | and the chunk size is no multiple of 3, so each chunk starts inside a straddling match
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "../string.h"
+#include "../par_string.h"
+#include "../thread_pool.h"
+
+static const u64 PAR_SIZES[] = { 1UL << 20, 8UL << 20, 32UL << 20 };
+static const u32 PAR_THREADS[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+static const char NEEDLE[] = "qzxjvkwq";
+static const char PERIODIC_NEEDLE[] = "aaa";
+
+typedef struct Bench_ctx {
+	u64 size;
+
+	// pristine text of size bytes, the needle sits at the very end
+	char* text;
+
+	// read-only String_t over text, like String_lit it is never mutated or freed
+	String_t view;
+
+	// size bytes of 'a' and the read-only view over them
+	char* periodic;
+	String_t periodic_view;
+
+	// String_t built by String.owned_from_n for the mutating cases
+	String_t str;
+
+	volatile u64 sink;
+} Bench_ctx;
+
+static void text_fill(char* _text, const u64 _size)
+{
+	u64 state = 0x9E3779B97F4A7C15UL;
+	for ( u64 idx = 0; idx < _size; ++idx ) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		const u64 pick = state % 32;
+		_text[idx] = (pick < 26) ? (char)('a' + pick) : ' ';
+	}
+	memcpy(_text + _size - (sizeof(NEEDLE) - 1), NEEDLE, sizeof(NEEDLE) - 1);
+	_text[_size] = '\0';
+}
+
+static void setup_none(void* _ctx) { (void)_ctx; }
+static void teardown_none(void* _ctx) { (void)_ctx; }
+
+static void setup_str(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	ctx->str = String.owned_from_n(ctx->text, ctx->size).contents;
+}
+
+static void teardown_str(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	String.free_owned(&ctx->str);
+}
+
+#define CTX ((Bench_ctx*)_ctx)
+#define RUN(_name) static void _name(void* _ctx)
+
+RUN(run_find) { CTX->sink += ParString.find(&CTX->view, NEEDLE).contents; }
+RUN(run_count) { CTX->sink += ParString.count(&CTX->view, " a"); }
+RUN(run_count_periodic) { CTX->sink += ParString.count(&CTX->periodic_view, PERIODIC_NEEDLE); }
+RUN(run_remove) { ParString.remove(&CTX->str, " a"); }
+RUN(run_replace_char) { ParString.replace_char(&CTX->str, ' ', '_'); }
+RUN(run_toupper) { ParString.toupper(&CTX->str); }
+RUN(run_tolower) { ParString.tolower(&CTX->str); }
+
+static const Bench_case PAR_CASES[] = {
+	{ "ParString.find",			"pool",	setup_none,	run_find,			teardown_none,	0 },
+	{ "ParString.count",		"pool",	setup_none,	run_count,			teardown_none,	0 },
+	{ "ParString.count_periodic",	"pool",	setup_none,	run_count_periodic,	teardown_none,	0 },
+	{ "ParString.remove",		"pool",	setup_str,	run_remove,			teardown_str,	BENCH_PER_SAMPLE },
+	{ "ParString.replace_char",	"pool",	setup_str,	run_replace_char,	teardown_str,	BENCH_PER_SAMPLE },
+	{ "ParString.toupper",		"pool",	setup_str,	run_toupper,		teardown_str,	BENCH_PER_SAMPLE },
+	{ "ParString.tolower",		"pool",	setup_str,	run_tolower,		teardown_str,	BENCH_PER_SAMPLE },
+};
+
+static Bench_result RESULT;
+
+int main(int argc, char** argv)
+{
+	bench_init(argc, argv);
+	ParString.set_threshold(0);
+
+	const long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	const u32 max_threads = (n_cpus > 2) ? (u32)n_cpus : 2;
+
+	Bench_ctx ctx;
+	for ( u64 size = 0; size < sizeof(PAR_SIZES) / sizeof(u64); ++size ) {
+		memset(&ctx, 0, sizeof(Bench_ctx));
+		ctx.size = PAR_SIZES[size];
+		ctx.text = (char*)malloc(ctx.size + 1);
+		text_fill(ctx.text, ctx.size);
+		ctx.view = (String_t){ .data = ctx.text, .size = ctx.size + 1, .len = ctx.size };
+		ctx.periodic = (char*)malloc(ctx.size + 1);
+		memset(ctx.periodic, 'a', ctx.size);
+		ctx.periodic[ctx.size] = '\0';
+		ctx.periodic_view = (String_t){ .data = ctx.periodic, .size = ctx.size + 1, .len = ctx.size };
+
+		for ( u64 threads = 0; threads < sizeof(PAR_THREADS) / sizeof(u32) && PAR_THREADS[threads] <= max_threads; ++threads ) {
+			Pool_t* pool = Pool.create(PAR_THREADS[threads] - 1);
+			if (!pool) continue;
+			ParString.set_pool(pool);
+
+			char impl[16];
+			snprintf(impl, sizeof(impl), "pool/%ut", Pool.threads(pool));
+			for ( u64 idx = 0; idx < sizeof(PAR_CASES) / sizeof(Bench_case); ++idx ) {
+				Bench_case bench = PAR_CASES[idx];
+				if (!bench_selected(&bench, argc, argv)) continue;
+				bench.impl = impl;
+
+				bench_run(&bench, &ctx, &RESULT);
+				bench_report(&bench, &RESULT, ctx.size, 0);
+			}
+
+			ParString.set_pool(NULL);
+			Pool.destroy(pool);
+		}
+		free(ctx.text);
+		free(ctx.periodic);
+	}
+	bench_finish();
+
+	return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ | Sorting and comparing String_t / SS_t collections against the qsort based code they replace
+ |
+ | Keys are short words behind a handful of shared prefixes, the shape of paths, URLs or
+ | namespaced identifiers, so comparisons regularly run past the first 8 bytes
+ | The size column is the number of strings and the last column reads as million strings per second
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../string.h"
+#include "../stack_string.h"
+#include "../string_sort.h"
+
+static const u64 SORT_SIZES[] = { 256, 4096, 65536 };
+
+static const char* PREFIXES[] = {
+	"", "id:", "usr/lib/", "home/ct/src/", "https://ct-stl.dev/", "ct::String::",
+};
+
+typedef struct Bench_ctx {
+	u64 n;
+
+	// pristine keys, copied into the working arrays before every sample
+	String_t* keys;
+	SS_t* ss_keys;
+
+	String_t* strings;
+	SS_t* ss;
+
+	volatile u64 sink;
+} Bench_ctx;
+
+static u64 key_fill(char* _buf, u64* _state)
+{
+	*_state ^= *_state << 13;
+	*_state ^= *_state >> 7;
+	*_state ^= *_state << 17;
+	const char* prefix = PREFIXES[*_state % (sizeof(PREFIXES) / sizeof(char*))];
+	u64 len = strlen(prefix);
+	memcpy(_buf, prefix, len);
+
+	const u64 n_suffix = 1 + (*_state >> 8) % 12;
+	for ( u64 idx = 0; idx < n_suffix; ++idx ) {
+		*_state ^= *_state << 13;
+		*_state ^= *_state >> 7;
+		*_state ^= *_state << 17;
+		_buf[len++] = (char)('a' + *_state % 26);
+	}
+	_buf[len] = '\0';
+	return len;
+}
+
+static void ctx_init(Bench_ctx* restrict _ctx, const u64 _n)
+{
+	memset(_ctx, 0, sizeof(Bench_ctx));
+	_ctx->n = _n;
+	_ctx->keys = (String_t*)malloc(_n * sizeof(String_t));
+	_ctx->ss_keys = (SS_t*)malloc(_n * sizeof(SS_t));
+	_ctx->strings = (String_t*)malloc(_n * sizeof(String_t));
+	_ctx->ss = (SS_t*)malloc(_n * sizeof(SS_t));
+
+	u64 state = 0x9E3779B97F4A7C15UL;
+	char buf[64];
+	for ( u64 idx = 0; idx < _n; ++idx ) {
+		const u64 len = key_fill(buf, &state);
+		_ctx->keys[idx] = String.owned_from_n(buf, len).contents;
+		// keep a NUL inside every SS_t so the strcmp baselines stay in bounds
+		buf[(len < Stack_Size - 2) ? len : Stack_Size - 2] = '\0';
+		_ctx->ss_keys[idx] = SS.owned_from(buf).contents;
+	}
+}
+
+static void ctx_free(Bench_ctx* restrict _ctx)
+{
+	for ( u64 idx = 0; idx < _ctx->n; ++idx ) String.free_owned(&_ctx->keys[idx]);
+	free(_ctx->keys);
+	free(_ctx->ss_keys);
+	free(_ctx->strings);
+	free(_ctx->ss);
+}
+
+static void setup_strings(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	memcpy(ctx->strings, ctx->keys, ctx->n * sizeof(String_t));
+}
+
+static void setup_ss(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	memcpy(ctx->ss, ctx->ss_keys, ctx->n * sizeof(SS_t));
+}
+
+static void setup_none(void* _ctx) { (void)_ctx; }
+static void teardown_none(void* _ctx) { (void)_ctx; }
+
+static int qsort_string_cstr(const void* _a, const void* _b)
+{
+	return strcmp(String.cstr((const String_t*)_a), String.cstr((const String_t*)_b));
+}
+
+static int qsort_string_cmp(const void* _a, const void* _b)
+{
+	return String.cmp((const String_t*)_a, (const String_t*)_b);
+}
+
+static int qsort_ss_cstr(const void* _a, const void* _b)
+{
+	return strcmp(((const SS_t*)_a)->data, ((const SS_t*)_b)->data);
+}
+
+static int qsort_ss_cmp(const void* _a, const void* _b)
+{
+	return SS.cmp((const SS_t*)_a, (const SS_t*)_b);
+}
+
+#define CTX ((Bench_ctx*)_ctx)
+#define RUN(_name) static void _name(void* _ctx)
+
+RUN(run_sort_string) { StringSort.string(CTX->strings, CTX->n); }
+RUN(run_sort_string_qsort_cstr) { qsort(CTX->strings, CTX->n, sizeof(String_t), qsort_string_cstr); }
+RUN(run_sort_string_qsort_cmp) { qsort(CTX->strings, CTX->n, sizeof(String_t), qsort_string_cmp); }
+RUN(run_sort_ss) { StringSort.ss(CTX->ss, CTX->n); }
+RUN(run_sort_ss_qsort_cstr) { qsort(CTX->ss, CTX->n, sizeof(SS_t), qsort_ss_cstr); }
+RUN(run_sort_ss_qsort_cmp) { qsort(CTX->ss, CTX->n, sizeof(SS_t), qsort_ss_cmp); }
+
+// compare every key with its neighbour, most pairs differ early or in length
+RUN(run_string_eq)
+{
+	u64 sum = 0;
+	for ( u64 idx = 1; idx < CTX->n; ++idx ) sum += String.eq(&CTX->keys[idx-1], &CTX->keys[idx]);
+	CTX->sink = sum;
+}
+
+RUN(run_string_eq_strcmp)
+{
+	u64 sum = 0;
+	for ( u64 idx = 1; idx < CTX->n; ++idx ) sum += (strcmp(CTX->keys[idx-1].data, CTX->keys[idx].data) == 0);
+	CTX->sink = sum;
+}
+
+RUN(run_string_cmp)
+{
+	i64 sum = 0;
+	for ( u64 idx = 1; idx < CTX->n; ++idx ) sum += String.cmp(&CTX->keys[idx-1], &CTX->keys[idx]);
+	CTX->sink = sum;
+}
+
+RUN(run_string_cmp_strcmp)
+{
+	i64 sum = 0;
+	for ( u64 idx = 1; idx < CTX->n; ++idx ) sum += strcmp(CTX->keys[idx-1].data, CTX->keys[idx].data);
+	CTX->sink = sum;
+}
+
+RUN(run_ss_eq)
+{
+	u64 sum = 0;
+	for ( u64 idx = 1; idx < CTX->n; ++idx ) sum += SS.eq(&CTX->ss_keys[idx-1], &CTX->ss_keys[idx]);
+	CTX->sink = sum;
+}
+
+RUN(run_ss_eq_strcmp)
+{
+	u64 sum = 0;
+	for ( u64 idx = 1; idx < CTX->n; ++idx ) sum += (strcmp(CTX->ss_keys[idx-1].data, CTX->ss_keys[idx].data) == 0);
+	CTX->sink = sum;
+}
+
+RUN(run_ss_cmp)
+{
+	i64 sum = 0;
+	for ( u64 idx = 1; idx < CTX->n; ++idx ) sum += SS.cmp(&CTX->ss_keys[idx-1], &CTX->ss_keys[idx]);
+	CTX->sink = sum;
+}
+
+RUN(run_ss_cmp_strcmp)
+{
+	i64 sum = 0;
+	for ( u64 idx = 1; idx < CTX->n; ++idx ) sum += strcmp(CTX->ss_keys[idx-1].data, CTX->ss_keys[idx].data);
+	CTX->sink = sum;
+}
+
+static const Bench_case SORT_CASES[] = {
+	{ "String.sort",	"ct_stl",			setup_strings,	run_sort_string,			teardown_none,	BENCH_PER_SAMPLE },
+	{ "String.sort",	"qsort/strcmp",		setup_strings,	run_sort_string_qsort_cstr,	teardown_none,	BENCH_PER_SAMPLE },
+	{ "String.sort",	"qsort/cmp",		setup_strings,	run_sort_string_qsort_cmp,	teardown_none,	BENCH_PER_SAMPLE },
+	{ "SS.sort",		"ct_stl",			setup_ss,		run_sort_ss,				teardown_none,	BENCH_PER_SAMPLE },
+	{ "SS.sort",		"qsort/strcmp",		setup_ss,		run_sort_ss_qsort_cstr,		teardown_none,	BENCH_PER_SAMPLE },
+	{ "SS.sort",		"qsort/cmp",		setup_ss,		run_sort_ss_qsort_cmp,		teardown_none,	BENCH_PER_SAMPLE },
+	{ "String.eq",		"ct_stl",			setup_none,		run_string_eq,				teardown_none,	0 },
+	{ "String.eq",		"libc/strcmp",		setup_none,		run_string_eq_strcmp,		teardown_none,	0 },
+	{ "String.cmp",		"ct_stl",			setup_none,		run_string_cmp,				teardown_none,	0 },
+	{ "String.cmp",		"libc/strcmp",		setup_none,		run_string_cmp_strcmp,		teardown_none,	0 },
+	{ "SS.eq",			"ct_stl",			setup_none,		run_ss_eq,					teardown_none,	0 },
+	{ "SS.eq",			"libc/strcmp",		setup_none,		run_ss_eq_strcmp,			teardown_none,	0 },
+	{ "SS.cmp",			"ct_stl",			setup_none,		run_ss_cmp,					teardown_none,	0 },
+	{ "SS.cmp",			"libc/strcmp",		setup_none,		run_ss_cmp_strcmp,			teardown_none,	0 },
+};
+
+static Bench_result RESULT;
+
+int main(int argc, char** argv)
+{
+	bench_init(argc, argv);
+	Bench_ctx ctx;
+
+	for ( u64 idx = 0; idx < sizeof(SORT_CASES) / sizeof(Bench_case); ++idx ) {
+		const Bench_case* bench = &SORT_CASES[idx];
+		if (!bench_selected(bench, argc, argv)) continue;
+
+		for ( u64 size = 0; size < sizeof(SORT_SIZES) / sizeof(u64); ++size ) {
+			ctx_init(&ctx, SORT_SIZES[size]);
+			bench_run(bench, &ctx, &RESULT);
+			bench_report(bench, &RESULT, SORT_SIZES[size], 0);
+			ctx_free(&ctx);
+		}
+	}
+	bench_finish();
+
+	return 0;
+}
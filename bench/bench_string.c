@@ -0,0 +1,397 @@
+/*
+ | Benchmarks every entry of the String and SS function tables across input sizes and
+ | misalignments, next to the libc routines they compete with
+ |
+ | Build and run with `make -C bench run`, or `./bench_string find append` to filter by name
+ | Mutating cases run on buffers with headroom and StackStrings sit at the front of a padded
+ | array, so a bounds regression shows up under `make SANITIZE=address,undefined` instead of
+ | silently corrupting the next case
+ | Every String_t the library may write to comes from a String constructor and goes back through
+ | String.free_owned, so the same table also runs as bench_string_cow with -DCT_STRING_COW
+*/
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "../string.h"
+#include "../stack_string.h"
+
+#define BENCH_MAX_ALIGN 16
+#define BENCH_SS_SLACK 8
+
+static const u64 STRING_SIZES[] = { 16, 256, 4096, 65536, 1048576 };
+static const u64 SS_SIZES[] = { 8, 16, 24 };
+static const u64 ALIGNS[] = { 0, 1, 7 };
+
+static const char NEEDLE[] = "qzxjvkwq";
+static const char SUFFIX[] = "0123456789abcdef";
+
+typedef struct Bench_ctx {
+	u64 size;
+	u64 align;
+
+	// pristine text of size bytes, NUL terminated, the needle sits at the very end
+	char* text;
+
+	// read-only String_t over view_mem+align, like String_lit it is never mutated, shared or freed
+	char* view_mem;
+	String_t view;
+
+	// String_t built by String.owned_from_n, with headroom so appends and inserts do not resize
+	String_t str;
+	String_t* ptr;
+	Optional(String_t) owned;
+	char* garbage;
+
+	// libc baselines
+	char* dst;
+
+	SS_t ss[BENCH_SS_SLACK];
+	Optional(SS_t) ss_owned;
+
+	FILE* file;
+	char path[64];
+	volatile u64 sink;
+} Bench_ctx;
+
+static void text_fill(char* _text, const u64 _size)
+{
+	u64 state = 0x9E3779B97F4A7C15UL;
+	for ( u64 idx = 0; idx < _size; ++idx ) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		const u64 pick = state % 32;
+		_text[idx] = (pick < 26) ? (char)('a' + pick) : ' ';
+	}
+	if (_size >= sizeof(NEEDLE) - 1)
+		memcpy(_text + _size - (sizeof(NEEDLE) - 1), NEEDLE, sizeof(NEEDLE) - 1);
+	_text[_size] = '\0';
+}
+
+static void str_make(Bench_ctx* restrict _ctx)
+{
+	_ctx->str = String.owned_from_n(_ctx->text, _ctx->size).contents;
+	String.resize(&_ctx->str, _ctx->size + 64);
+}
+
+static void view_reset(Bench_ctx* restrict _ctx)
+{
+	memcpy(_ctx->view.data, _ctx->text, _ctx->size + 1);
+	_ctx->view.len = _ctx->size;
+}
+
+static void ss_make(Bench_ctx* restrict _ctx)
+{
+	memset(_ctx->ss, 0, sizeof(_ctx->ss));
+	for ( u64 idx = 0; idx < BENCH_SS_SLACK; ++idx ) SS.clear(&_ctx->ss[idx]);
+	memcpy(_ctx->ss[0].data, _ctx->text, _ctx->size);
+	_ctx->ss[0].data[_ctx->size] = '\0';
+	_ctx->ss[0].data[Stack_Size-1] = (Stack_Size - _ctx->size);
+}
+
+static void setup_view(void* _ctx) { view_reset((Bench_ctx*)_ctx); }
+static void setup_str(void* _ctx) { str_make((Bench_ctx*)_ctx); }
+static void setup_ss(void* _ctx) { ss_make((Bench_ctx*)_ctx); }
+static void setup_none(void* _ctx) { (void)_ctx; }
+
+static void setup_dst(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	memcpy(ctx->dst, ctx->text, ctx->size + 1);
+}
+
+static void setup_file(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	ctx->file = fopen(ctx->path, "rb");
+}
+
+static void setup_file_str(void* _ctx)
+{
+	setup_file(_ctx);
+	str_make((Bench_ctx*)_ctx);
+}
+
+static void setup_shared(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	str_make(ctx);
+	ctx->owned = String.share(&ctx->str);
+}
+
+static void setup_ptr(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	ctx->ptr = String.from(ctx->text);
+}
+
+static void teardown_none(void* _ctx) { (void)_ctx; }
+
+static void teardown_str(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	String.free_owned(&ctx->str);
+}
+
+static void teardown_garbage(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	free(ctx->garbage);
+	ctx->garbage = NULL;
+}
+
+static void teardown_ptr(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	if (ctx->ptr) String.free(ctx->ptr);
+	ctx->ptr = NULL;
+}
+
+static void teardown_owned(void* _ctx)
+{
+	Bench_ctx* ctx = (Bench_ctx*)_ctx;
+	if (IsSome_owned(ctx->owned)) String.free_owned(&ctx->owned.contents);
+	ctx->owned = None(String_t);
+}
+
+static void teardown_shared(void* _ctx)
+{
+	teardown_owned(_ctx);
+	teardown_str(_ctx);
+}
+
+#define CTX ((Bench_ctx*)_ctx)
+#define RUN(_name) static void _name(void* _ctx)
+
+/*
+ | String_funcs
+*/
+RUN(run_owned_from) { CTX->owned = String.owned_from(CTX->text); }
+RUN(run_owned_from_n) { CTX->owned = String.owned_from_n(CTX->text, CTX->size); }
+RUN(run_from) { CTX->ptr = String.from(CTX->text); }
+RUN(run_from_n) { CTX->ptr = String.from_n(CTX->text, CTX->size); }
+RUN(run_from_file) { CTX->ptr = String.from_file(CTX->file); }
+RUN(run_owned_slice_from) { CTX->owned = String.owned_slice_from(CTX->text, 0, CTX->size / 2); }
+RUN(run_slice_from) { CTX->ptr = String.slice_from(CTX->text, 0, CTX->size / 2); }
+RUN(run_size) { CTX->sink += String.size(&CTX->view); }
+RUN(run_len) { CTX->sink += String.len(&CTX->view); }
+RUN(run_cstr) { CTX->sink += (u64)String.cstr(&CTX->view); }
+RUN(run_owned_cstr) { CTX->garbage = String.owned_cstr(&CTX->view); }
+RUN(run_append) { String.append(&CTX->str, SUFFIX); }
+RUN(run_append_n) { String.append_n(&CTX->str, SUFFIX, sizeof(SUFFIX) - 1); }
+RUN(run_append_str) { String.append_str(&CTX->str, &CTX->view); }
+RUN(run_append_file) { String.append_file(&CTX->str, CTX->file); }
+RUN(run_at) { CTX->sink += (u64)String.at(&CTX->view, CTX->size / 2); }
+RUN(run_begin) { CTX->sink += (u64)String.begin(&CTX->view); }
+RUN(run_end) { CTX->sink += (u64)String.end(&CTX->view); }
+RUN(run_slice) { String.slice(&CTX->str, 1, CTX->size / 2); }
+RUN(run_remove) { String.remove(&CTX->str, NEEDLE); }
+RUN(run_remove_all) { String.remove_all(&CTX->str, " "); }
+RUN(run_replace_all_grow) { String.replace_all(&CTX->str, " ", "__"); }
+RUN(run_replace_all_shrink) { String.replace_all(&CTX->str, " a", "_"); }
+RUN(run_replace_all_n) { String.replace_all_n(&CTX->str, " a", 2, "\0", 1); }
+RUN(run_remove_slice) { String.remove_slice(&CTX->str, 0, CTX->size / 2); }
+RUN(run_strip) { String.strip(&CTX->str, " "); }
+RUN(run_insert) { String.insert(&CTX->str, NEEDLE, CTX->size / 2); }
+RUN(run_insert_n) { String.insert_n(&CTX->str, NEEDLE, sizeof(NEEDLE) - 1, CTX->size / 2); }
+RUN(run_insert_str) { String.insert_str(&CTX->str, &CTX->view, 0); }
+RUN(run_replace) { String.replace(&CTX->str, 'x', CTX->size / 2); }
+RUN(run_rev) { String.rev(&CTX->str); }
+RUN(run_toupper) { (String.toupper)(&CTX->str); }
+RUN(run_tolower) { (String.tolower)(&CTX->str); }
+RUN(run_find) { CTX->sink += String.find(&CTX->view, NEEDLE).contents; }
+RUN(run_find_n) { CTX->sink += String.find_n(&CTX->view, NEEDLE, sizeof(NEEDLE) - 1).contents; }
+RUN(run_resize) { String.resize(&CTX->str, 64); }
+RUN(run_shrink) { String.shrink(&CTX->str); }
+RUN(run_clear) { String.clear(&CTX->str); }
+RUN(run_free) { String.free(CTX->ptr); CTX->ptr = NULL; }
+RUN(run_free_owned) { String.free_owned(&CTX->str); }
+RUN(run_share) { CTX->owned = String.share(&CTX->str); }
+RUN(run_refs) { CTX->sink += String.refs(&CTX->str); }
+RUN(run_make_unique) { String.make_unique(&CTX->str); }
+
+/*
+ | libc baselines
+*/
+RUN(run_libc_strstr) { CTX->sink += (u64)strstr(CTX->view.data, NEEDLE); }
+RUN(run_libc_memmem) { CTX->sink += (u64)memmem(CTX->view.data, CTX->view.len, NEEDLE, sizeof(NEEDLE) - 1); }
+RUN(run_libc_strcat) { strcat(CTX->dst, SUFFIX); }
+RUN(run_libc_strdup) { CTX->garbage = strdup(CTX->view.data); }
+RUN(run_libc_toupper)
+{
+	char* data = CTX->str.data;
+	for ( u64 idx = 0; idx < CTX->str.len; ++idx ) data[idx] = (char)toupper((u8)data[idx]);
+}
+
+/*
+ | StackString
+*/
+RUN(run_ss_owned_from) { CTX->ss_owned = SS.owned_from(CTX->text); }
+RUN(run_ss_len) { CTX->sink += SS.len(&CTX->ss[0]); }
+RUN(run_ss_size) { CTX->sink += SS.size(&CTX->ss[0]); }
+RUN(run_ss_cstr) { CTX->sink += (u64)SS.cstr(&CTX->ss[0]); }
+RUN(run_ss_owned_cstr) { CTX->garbage = SS.owned_cstr(&CTX->ss[0]); }
+RUN(run_ss_at) { CTX->sink += (u64)SS.at(&CTX->ss[0], CTX->size / 2); }
+RUN(run_ss_begin) { CTX->sink += (u64)SS.begin(&CTX->ss[0]); }
+RUN(run_ss_end) { CTX->sink += (u64)SS.end(&CTX->ss[0]); }
+RUN(run_ss_slice) { SS.slice(&CTX->ss[0], 1, CTX->size / 2); }
+RUN(run_ss_owned_slice) { CTX->ss_owned = SS.owned_slice(&CTX->ss[0], 0, CTX->size / 2); }
+RUN(run_ss_append) { SS.append(&CTX->ss[0], "abcd"); }
+RUN(run_ss_append_n) { SS.append_n(&CTX->ss[0], "abcd", 4); }
+RUN(run_ss_insert) { SS.insert(&CTX->ss[0], "abcd", CTX->size / 2); }
+RUN(run_ss_toupper) { (SS.toupper)(&CTX->ss[0]); }
+RUN(run_ss_tolower) { (SS.tolower)(&CTX->ss[0]); }
+RUN(run_ss_find) { CTX->sink += SS.find(&CTX->ss[0], "qzx").contents; }
+RUN(run_ss_replace) { SS.replace(&CTX->ss[0], 'x', CTX->size / 2); }
+RUN(run_ss_strip) { SS.strip(&CTX->ss[0], " "); }
+RUN(run_ss_clear) { SS.clear(&CTX->ss[0]); }
+
+static const Bench_case STRING_CASES[] = {
+	{ "String.owned_from",		"ct_stl",	setup_none,		run_owned_from,			teardown_owned,		BENCH_PER_SAMPLE },
+	{ "String.owned_from_n",	"ct_stl",	setup_none,		run_owned_from_n,		teardown_owned,		BENCH_PER_SAMPLE },
+	{ "String.from",			"ct_stl",	setup_none,		run_from,				teardown_ptr,		BENCH_PER_SAMPLE },
+	{ "String.from_n",			"ct_stl",	setup_none,		run_from_n,				teardown_ptr,		BENCH_PER_SAMPLE },
+	{ "String.from_file",		"ct_stl",	setup_file,		run_from_file,			teardown_ptr,		BENCH_PER_SAMPLE },
+	{ "String.owned_slice_from","ct_stl",	setup_none,		run_owned_slice_from,	teardown_owned,		BENCH_PER_SAMPLE },
+	{ "String.slice_from",		"ct_stl",	setup_none,		run_slice_from,			teardown_ptr,		BENCH_PER_SAMPLE },
+	{ "String.size",			"ct_stl",	setup_view,		run_size,				teardown_none,		0 },
+	{ "String.len",				"ct_stl",	setup_view,		run_len,				teardown_none,		0 },
+	{ "String.cstr",			"ct_stl",	setup_view,		run_cstr,				teardown_none,		0 },
+	{ "String.owned_cstr",		"ct_stl",	setup_view,		run_owned_cstr,			teardown_garbage,	BENCH_PER_SAMPLE | BENCH_ALIGN },
+	{ "String.owned_cstr",		"libc/strdup",	setup_view,	run_libc_strdup,		teardown_garbage,	BENCH_PER_SAMPLE | BENCH_ALIGN },
+	{ "String.append",			"ct_stl",	setup_str,		run_append,				teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.append",			"libc/strcat",	setup_dst,	run_libc_strcat,		teardown_none,		BENCH_PER_SAMPLE },
+	{ "String.append_n",		"ct_stl",	setup_str,		run_append_n,			teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.append_str",		"ct_stl",	setup_str,		run_append_str,			teardown_str,		BENCH_PER_SAMPLE | BENCH_ALIGN },
+	{ "String.append_file",		"ct_stl",	setup_file_str,	run_append_file,		teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.at",				"ct_stl",	setup_view,		run_at,					teardown_none,		0 },
+	{ "String.begin",			"ct_stl",	setup_view,		run_begin,				teardown_none,		0 },
+	{ "String.end",				"ct_stl",	setup_view,		run_end,				teardown_none,		0 },
+	{ "String.slice",			"ct_stl",	setup_str,		run_slice,				teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.remove",			"ct_stl",	setup_str,		run_remove,				teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.remove_all",		"ct_stl",	setup_str,		run_remove_all,			teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.remove_slice",	"ct_stl",	setup_str,		run_remove_slice,		teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.strip",			"ct_stl",	setup_str,		run_strip,				teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.insert",			"ct_stl",	setup_str,		run_insert,				teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.insert_n",		"ct_stl",	setup_str,		run_insert_n,			teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.insert_str",		"ct_stl",	setup_str,		run_insert_str,			teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.replace",			"ct_stl",	setup_str,		run_replace,			teardown_str,		0 },
+	{ "String.replace_all",	"grow",		setup_str,		run_replace_all_grow,	teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.replace_all",	"shrink",	setup_str,		run_replace_all_shrink,	teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.replace_all_n",	"ct_stl",	setup_str,		run_replace_all_n,		teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.rev",				"ct_stl",	setup_str,		run_rev,				teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.toupper",			"ct_stl",	setup_str,		run_toupper,			teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.toupper",			"libc/toupper",	setup_str,	run_libc_toupper,		teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.tolower",			"ct_stl",	setup_str,		run_tolower,			teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.find",			"ct_stl",	setup_view,		run_find,				teardown_none,		BENCH_ALIGN },
+	{ "String.find_n",			"ct_stl",	setup_view,		run_find_n,				teardown_none,		BENCH_ALIGN },
+	{ "String.find",			"libc/strstr",	setup_view,	run_libc_strstr,		teardown_none,		BENCH_ALIGN },
+	{ "String.find",			"libc/memmem",	setup_view,	run_libc_memmem,		teardown_none,		BENCH_ALIGN },
+	{ "String.resize",			"ct_stl",	setup_str,		run_resize,				teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.shrink",			"ct_stl",	setup_str,		run_shrink,				teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.clear",			"ct_stl",	setup_str,		run_clear,				teardown_str,		BENCH_PER_SAMPLE },
+	{ "String.free",			"ct_stl",	setup_ptr,		run_free,				teardown_ptr,		BENCH_PER_SAMPLE },
+	{ "String.free_owned",		"ct_stl",	setup_str,		run_free_owned,			teardown_none,		BENCH_PER_SAMPLE },
+	{ "String.share",			"ct_stl",	setup_str,		run_share,				teardown_shared,	BENCH_PER_SAMPLE },
+	{ "String.refs",			"ct_stl",	setup_str,		run_refs,				teardown_str,		0 },
+	{ "String.make_unique",		"unshared",	setup_str,		run_make_unique,		teardown_str,		0 },
+	{ "String.make_unique",		"shared",	setup_shared,	run_make_unique,		teardown_shared,	BENCH_PER_SAMPLE },
+};
+
+static const Bench_case SS_CASES[] = {
+	{ "SS.owned_from",			"ct_stl",	setup_ss,		run_ss_owned_from,		teardown_none,		0 },
+	{ "SS.len",					"ct_stl",	setup_ss,		run_ss_len,				teardown_none,		0 },
+	{ "SS.size",				"ct_stl",	setup_ss,		run_ss_size,			teardown_none,		0 },
+	{ "SS.cstr",				"ct_stl",	setup_ss,		run_ss_cstr,			teardown_none,		0 },
+	{ "SS.owned_cstr",			"ct_stl",	setup_ss,		run_ss_owned_cstr,		teardown_garbage,	BENCH_PER_SAMPLE },
+	{ "SS.at",					"ct_stl",	setup_ss,		run_ss_at,				teardown_none,		0 },
+	{ "SS.begin",				"ct_stl",	setup_ss,		run_ss_begin,			teardown_none,		0 },
+	{ "SS.end",					"ct_stl",	setup_ss,		run_ss_end,				teardown_none,		0 },
+	{ "SS.slice",				"ct_stl",	setup_ss,		run_ss_slice,			teardown_none,		BENCH_PER_SAMPLE },
+	{ "SS.owned_slice",			"ct_stl",	setup_ss,		run_ss_owned_slice,		teardown_none,		0 },
+	{ "SS.append",				"ct_stl",	setup_ss,		run_ss_append,			teardown_none,		BENCH_PER_SAMPLE },
+	{ "SS.append_n",			"ct_stl",	setup_ss,		run_ss_append_n,		teardown_none,		BENCH_PER_SAMPLE },
+	{ "SS.insert",				"ct_stl",	setup_ss,		run_ss_insert,			teardown_none,		BENCH_PER_SAMPLE },
+	{ "SS.toupper",				"ct_stl",	setup_ss,		run_ss_toupper,			teardown_none,		BENCH_PER_SAMPLE },
+	{ "SS.tolower",				"ct_stl",	setup_ss,		run_ss_tolower,			teardown_none,		BENCH_PER_SAMPLE },
+	{ "SS.find",				"ct_stl",	setup_ss,		run_ss_find,			teardown_none,		BENCH_PER_SAMPLE },
+	{ "SS.replace",				"ct_stl",	setup_ss,		run_ss_replace,			teardown_none,		0 },
+	{ "SS.strip",				"ct_stl",	setup_ss,		run_ss_strip,			teardown_none,		BENCH_PER_SAMPLE },
+	{ "SS.clear",				"ct_stl",	setup_ss,		run_ss_clear,			teardown_none,		0 },
+};
+
+static Bench_result RESULT;
+
+static void ctx_init(Bench_ctx* restrict _ctx, const u64 _size, const u64 _align)
+{
+	memset(_ctx, 0, sizeof(Bench_ctx));
+	_ctx->size = _size;
+	_ctx->align = _align;
+	_ctx->owned = None(String_t);
+
+	_ctx->text = (char*)malloc(_size + 1);
+	text_fill(_ctx->text, _size);
+
+	_ctx->view_mem = (char*)aligned_alloc(64, mem_round(_size + BENCH_MAX_ALIGN + 1, 64));
+	_ctx->view.data = _ctx->view_mem + _align;
+	_ctx->view.size = _size + 1;
+	view_reset(_ctx);
+
+	_ctx->dst = (char*)malloc(_size + sizeof(SUFFIX) + 1);
+
+	snprintf(_ctx->path, sizeof(_ctx->path), "/tmp/ct_stl_bench_%d.txt", (int)getpid());
+	FILE* file = fopen(_ctx->path, "wb");
+	if (file) {
+		fwrite(_ctx->text, 1, _size, file);
+		fclose(file);
+	}
+}
+
+static void ctx_free(Bench_ctx* restrict _ctx)
+{
+	remove(_ctx->path);
+	free(_ctx->text);
+	free(_ctx->view_mem);
+	free(_ctx->dst);
+}
+
+int main(int argc, char** argv)
+{
+	bench_init(argc, argv);
+	Bench_ctx ctx;
+
+	for ( u64 idx = 0; idx < sizeof(STRING_CASES) / sizeof(Bench_case); ++idx ) {
+		const Bench_case* bench = &STRING_CASES[idx];
+		if (!bench_selected(bench, argc, argv)) continue;
+
+		for ( u64 size = 0; size < sizeof(STRING_SIZES) / sizeof(u64); ++size ) {
+			const u64 n_aligns = (bench->flags & BENCH_ALIGN) ? sizeof(ALIGNS) / sizeof(u64) : 1;
+			for ( u64 align = 0; align < n_aligns; ++align ) {
+				ctx_init(&ctx, STRING_SIZES[size], ALIGNS[align]);
+				bench_run(bench, &ctx, &RESULT);
+				bench_report(bench, &RESULT, STRING_SIZES[size], ALIGNS[align]);
+				ctx_free(&ctx);
+			}
+		}
+	}
+
+	for ( u64 idx = 0; idx < sizeof(SS_CASES) / sizeof(Bench_case); ++idx ) {
+		const Bench_case* bench = &SS_CASES[idx];
+		if (!bench_selected(bench, argc, argv)) continue;
+
+		for ( u64 size = 0; size < sizeof(SS_SIZES) / sizeof(u64); ++size ) {
+			ctx_init(&ctx, SS_SIZES[size], 0);
+			bench_run(bench, &ctx, &RESULT);
+			bench_report(bench, &RESULT, SS_SIZES[size], 0);
+			ctx_free(&ctx);
+		}
+	}
+
+	bench_finish();
+	return 0;
+}
@@ -0,0 +1,547 @@
+/*
+ | Differential fuzzer for String_t and SS_t
+ | Every input is decoded into a sequence of operations, each one is applied to the library and
+ | to a plain byte array model, and the two have to agree on the result, the bytes and the length
+ | after every step, including calls whose source aliases the destination like append_str(s, s)
+ |
+ | Built with clang -fsanitize=fuzzer this is a libFuzzer target, built with -DFUZZ_STANDALONE
+ | it gets its own main that replays the files named on the command line, or without any runs
+ | FUZZ_RUNS random inputs, so `make -C fuzz fuzz` works with any C compiler
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../string.h"
+#include "../stack_string.h"
+
+#define FUZZ_MAX_LEN 4096
+#define FUZZ_MAX_PAYLOAD 32
+
+#define FUZZ_CHECK(_cond) \
+	do { \
+		if (!(_cond)) { \
+			fprintf(stderr, "%s:%d: model mismatch: %s\n", __FILE__, __LINE__, #_cond); \
+			abort(); \
+		} \
+	} while (0) // End FUZZ_CHECK
+
+typedef struct Fuzz_in {
+	const u8* data;
+	u64 size;
+	u64 pos;
+} Fuzz_in;
+
+typedef struct Fuzz_ref {
+	char data[FUZZ_MAX_LEN];
+	u64 len;
+} Fuzz_ref;
+
+static u8 fuzz_u8(Fuzz_in* _in)
+{
+	return (_in->pos < _in->size) ? _in->data[_in->pos++] : 0;
+}
+
+static u64 fuzz_below(Fuzz_in* _in, const u64 _bound)
+{
+	// two bytes so indexes past 255 stay reachable once the string has grown
+	const u64 raw = ((u64)fuzz_u8(_in) << 8) | fuzz_u8(_in);
+	return _bound ? raw % _bound : 0;
+}
+
+static u64 fuzz_payload(Fuzz_in* _in, char* _buf, const u64 _max)
+/*
+ | Reads a byte range of up to _max bytes, the alphabet is small so searches actually match
+*/
+{
+	const u64 len = fuzz_u8(_in) % (_max + 1);
+	for ( u64 idx = 0; idx < len; ++idx ) _buf[idx] = "abAB \0,z"[fuzz_u8(_in) & 7];
+	return len;
+}
+
+static u64 fuzz_cstr(Fuzz_in* _in, char* _buf, const u64 _max)
+{
+	u64 len = fuzz_payload(_in, _buf, _max);
+	for ( u64 idx = 0; idx < len; ++idx ) if (_buf[idx] == '\0') _buf[idx] = 'z';
+	_buf[len] = '\0';
+	return len;
+}
+
+static void ref_insert(Fuzz_ref* _ref, const u64 _idx, const char* _bytes, const u64 _len)
+{
+	memmove(_ref->data + _idx + _len, _ref->data + _idx, _ref->len - _idx);
+	memcpy(_ref->data + _idx, _bytes, _len);
+	_ref->len += _len;
+}
+
+static void ref_erase(Fuzz_ref* _ref, const u64 _start, const u64 _end)
+{
+	memmove(_ref->data + _start, _ref->data + _end, _ref->len - _end);
+	_ref->len -= _end - _start;
+}
+
+static i64 ref_find(const char* _hay, const u64 _hay_len, const char* _needle, const u64 _needle_len)
+{
+	for ( u64 idx = 0; idx + _needle_len <= _hay_len; ++idx )
+		if (memcmp(_hay + idx, _needle, _needle_len) == 0) return (i64)idx;
+	return -1;
+}
+
+static u64 ref_replace_all(const Fuzz_ref* _ref, char* _out, const char* _needle, const u64 _needle_len, const char* _replacement, const u64 _replacement_len)
+/*
+ | Non-overlapping left to right replacement into _out, returns the new length or FUZZ_MAX_LEN when it would not fit
+*/
+{
+	u64 len = 0;
+	for ( u64 idx = 0; idx < _ref->len; ) {
+		if (idx + _needle_len <= _ref->len && memcmp(_ref->data + idx, _needle, _needle_len) == 0) {
+			if (len + _replacement_len >= FUZZ_MAX_LEN) return FUZZ_MAX_LEN;
+			memcpy(_out + len, _replacement, _replacement_len);
+			len += _replacement_len;
+			idx += _needle_len;
+			continue;
+		}
+		if (len + 1 >= FUZZ_MAX_LEN) return FUZZ_MAX_LEN;
+		_out[len++] = _ref->data[idx++];
+	}
+	return len;
+}
+
+static i32 ref_cmp(const char* _a, const u64 _a_len, const char* _b, const u64 _b_len)
+{
+	const i32 order = memcmp(_a, _b, (_a_len < _b_len) ? _a_len : _b_len);
+	if (order) return order;
+	return (_a_len > _b_len) - (_a_len < _b_len);
+}
+
+static i32 sign(const i32 _x) { return (_x > 0) - (_x < 0); }
+
+static void check_string(const String_t* _string, const Fuzz_ref* _ref)
+{
+	FUZZ_CHECK(_string->len == _ref->len);
+	FUZZ_CHECK(_string->len < _string->size);
+	FUZZ_CHECK(memcmp(_string->data, _ref->data, _ref->len) == 0);
+	FUZZ_CHECK(_string->data[_string->len] == '\0');
+}
+
+static void check_ss(const SS_t* _string, const Fuzz_ref* _ref)
+{
+	FUZZ_CHECK(StackString_len(_string) == _ref->len);
+	FUZZ_CHECK(memcmp(_string->data, _ref->data, _ref->len) == 0);
+	if (_ref->len < Stack_Size - 1) FUZZ_CHECK(_string->data[_ref->len] == '\0');
+}
+
+static void fuzz_string_op(Fuzz_in* _in, String_t* _string, Fuzz_ref* _ref, String_t* _snap, Fuzz_ref* _snap_ref, bool* _has_snap)
+{
+	char buf[FUZZ_MAX_PAYLOAD + 1];
+	char out[FUZZ_MAX_LEN];
+	const u64 len = _ref->len;
+	const u64 start = fuzz_below(_in, len + 2);
+	const u64 end = fuzz_below(_in, len + 2);
+
+	switch ( fuzz_u8(_in) % 22 ) {
+	case 0: {
+		const u64 n = fuzz_payload(_in, buf, FUZZ_MAX_PAYLOAD);
+		if (len + n >= FUZZ_MAX_LEN) break;
+		FUZZ_CHECK(String.append_n(_string, buf, n));
+		ref_insert(_ref, len, buf, n);
+		break;
+	}
+	case 1: {
+		const u64 n = fuzz_cstr(_in, buf, FUZZ_MAX_PAYLOAD);
+		if (len + n >= FUZZ_MAX_LEN) break;
+		FUZZ_CHECK(String.append(_string, buf));
+		ref_insert(_ref, len, buf, n);
+		break;
+	}
+	case 2: {
+		// the whole string appended to itself
+		if (2 * len >= FUZZ_MAX_LEN) break;
+		FUZZ_CHECK(String.append_str(_string, _string));
+		ref_insert(_ref, len, _ref->data, len);
+		break;
+	}
+	case 3: {
+		// a slice of the string appended to itself
+		if (start > end || end > len || len + (end - start) >= FUZZ_MAX_LEN) break;
+		FUZZ_CHECK(String.append_n(_string, _string->data + start, end - start));
+		memcpy(out, _ref->data + start, end - start);
+		ref_insert(_ref, len, out, end - start);
+		break;
+	}
+	case 4: {
+		const u64 n = fuzz_payload(_in, buf, FUZZ_MAX_PAYLOAD);
+		if (len + n >= FUZZ_MAX_LEN) break;
+		FUZZ_CHECK(String.insert_n(_string, buf, n, start) == (start <= len));
+		if (start <= len) ref_insert(_ref, start, buf, n);
+		break;
+	}
+	case 5: {
+		if (2 * len >= FUZZ_MAX_LEN) break;
+		FUZZ_CHECK(String.insert_str(_string, _string, start) == (start <= len));
+		memcpy(out, _ref->data, len);
+		if (start <= len) ref_insert(_ref, start, out, len);
+		break;
+	}
+	case 6: {
+		// a slice of the string inserted into itself, before, across or after the insertion point
+		const u64 idx = fuzz_below(_in, len + 1);
+		if (start > end || end > len || len + (end - start) >= FUZZ_MAX_LEN) break;
+		FUZZ_CHECK(String.insert_n(_string, _string->data + start, end - start, idx));
+		memcpy(out, _ref->data + start, end - start);
+		ref_insert(_ref, idx, out, end - start);
+		break;
+	}
+	case 7: {
+		const bool valid = start <= end && end <= len;
+		FUZZ_CHECK(String.slice(_string, start, end) == valid);
+		if (valid) {
+			memmove(_ref->data, _ref->data + start, end - start);
+			_ref->len = end - start;
+		}
+		break;
+	}
+	case 8: {
+		const bool valid = start <= end && end <= len;
+		FUZZ_CHECK(String.remove_slice(_string, start, end) == valid);
+		if (valid) ref_erase(_ref, start, end);
+		break;
+	}
+	case 9: {
+		const char* at = String.at(_string, start);
+		FUZZ_CHECK((at != NULL) == (start < len));
+		if (at) FUZZ_CHECK(*at == _ref->data[start]);
+		FUZZ_CHECK(String.begin(_string) == _string->data);
+		FUZZ_CHECK(String.end(_string) == _string->data + len);
+		break;
+	}
+	case 10: {
+		u64 n = fuzz_payload(_in, buf, 7);
+		if (n == 0) buf[n++] = 'a';
+		const Optional(u64) found = String.find_n(_string, buf, n);
+		const i64 expected = ref_find(_ref->data, len, buf, n);
+		FUZZ_CHECK(IsSome_owned(found) == (expected >= 0));
+		if (expected >= 0) FUZZ_CHECK(found.contents == (u64)expected);
+		break;
+	}
+	case 11: {
+		fuzz_cstr(_in, buf, 3);
+		FUZZ_CHECK(String.strip(_string, buf));
+		u64 kept = 0;
+		for ( u64 idx = 0; idx < len; ++idx )
+			if (_ref->data[idx] == '\0' || !strchr(buf, _ref->data[idx])) _ref->data[kept++] = _ref->data[idx];
+		_ref->len = kept;
+		break;
+	}
+	case 12: {
+		FUZZ_CHECK(String.rev(_string));
+		for ( u64 idx = 0; idx < len / 2; ++idx ) {
+			const char tmp = _ref->data[idx];
+			_ref->data[idx] = _ref->data[len - 1 - idx];
+			_ref->data[len - 1 - idx] = tmp;
+		}
+		break;
+	}
+	case 13: {
+		FUZZ_CHECK(String.toupper(_string));
+		for ( u64 idx = 0; idx < len; ++idx ) if (_ref->data[idx] >= 'a' && _ref->data[idx] <= 'z') _ref->data[idx] -= 32;
+		break;
+	}
+	case 14: {
+		FUZZ_CHECK(String.tolower(_string));
+		for ( u64 idx = 0; idx < len; ++idx ) if (_ref->data[idx] >= 'A' && _ref->data[idx] <= 'Z') _ref->data[idx] += 32;
+		break;
+	}
+	case 15: {
+		char replacement[FUZZ_MAX_PAYLOAD];
+		u64 n = fuzz_payload(_in, buf, 3);
+		if (n == 0) buf[n++] = ' ';
+		const u64 replacement_len = fuzz_payload(_in, replacement, 4);
+		// now and then both are taken from the string's own bytes, which the rewrite overwrites
+		const bool aliased = (fuzz_u8(_in) & 3) == 0 && start + n + replacement_len <= len;
+		if (aliased) {
+			memcpy(buf, _ref->data + start, n);
+			memcpy(replacement, _ref->data + start + n, replacement_len);
+		}
+		const u64 new_len = ref_replace_all(_ref, out, buf, n, replacement, replacement_len);
+		if (new_len >= FUZZ_MAX_LEN) break;
+		const char* needle = aliased ? _string->data + start : buf;
+		const char* with = aliased ? _string->data + start + n : replacement;
+		FUZZ_CHECK(String.replace_all_n(_string, needle, n, with, replacement_len) == (ref_find(_ref->data, len, buf, n) >= 0));
+		memcpy(_ref->data, out, new_len);
+		_ref->len = new_len;
+		break;
+	}
+	case 16: {
+		const u64 n = fuzz_cstr(_in, buf, 3);
+		if (n == 0) break;
+		String.remove_all(_string, buf);
+		_ref->len = ref_replace_all(_ref, out, buf, n, "", 0);
+		memcpy(_ref->data, out, _ref->len);
+		break;
+	}
+	case 17: {
+		const char c = (char)fuzz_u8(_in);
+		FUZZ_CHECK(String.replace(_string, c, start) == (start < len));
+		if (start < len) _ref->data[start] = c;
+		break;
+	}
+	case 18: {
+		// a shared handle taken now has to keep its bytes whatever happens to _string afterwards
+		if (*_has_snap) {
+			check_string(_snap, _snap_ref);
+			FUZZ_CHECK(String.free_owned(_snap));
+			*_has_snap = false;
+			break;
+		}
+		const Optional(String_t) shared = String.share(_string);
+		FUZZ_CHECK(IsSome_owned(shared));
+		*_snap = shared.contents;
+		memcpy(_snap_ref->data, _ref->data, len);
+		_snap_ref->len = len;
+		*_has_snap = true;
+		break;
+	}
+	case 19: {
+		FUZZ_CHECK(String.make_unique(_string));
+		FUZZ_CHECK(String.refs(_string) == 1);
+		break;
+	}
+	case 20: {
+		const u64 n = fuzz_payload(_in, buf, FUZZ_MAX_PAYLOAD);
+		const u64 shared_len = (n < len) ? n : len;
+		// mostly a copy of the string's own head, so compares run past the first bytes
+		if (fuzz_u8(_in) & 1) memcpy(buf, _ref->data, shared_len);
+		Optional(String_t) other = String.owned_from_n(buf, n);
+		FUZZ_CHECK(IsSome_owned(other));
+		FUZZ_CHECK(sign(String.cmp(_string, &other.contents)) == sign(ref_cmp(_ref->data, len, buf, n)));
+		FUZZ_CHECK(sign(String.cmp(&other.contents, _string)) == sign(ref_cmp(buf, n, _ref->data, len)));
+		FUZZ_CHECK(String.eq(_string, &other.contents) == (n == len && memcmp(buf, _ref->data, n) == 0));
+		FUZZ_CHECK(String.cmp(_string, _string) == 0 && String.eq(_string, _string));
+		String.free_owned(&other.contents);
+		break;
+	}
+	case 21: {
+		const u8 which = fuzz_u8(_in) % 3;
+		if (which == 0) FUZZ_CHECK(String.shrink(_string));
+		else if (which == 1) FUZZ_CHECK(String.resize(_string, fuzz_u8(_in)));
+		else {
+			FUZZ_CHECK(String.clear(_string));
+			_ref->len = 0;
+		}
+		break;
+	}
+	}
+}
+
+static void fuzz_ss_op(Fuzz_in* _in, SS_t* _string, Fuzz_ref* _ref)
+{
+	char buf[FUZZ_MAX_PAYLOAD + 1];
+	const u64 len = _ref->len;
+	const u16 start = (u16)fuzz_below(_in, len + 2);
+	const u16 end = (u16)fuzz_below(_in, len + 2);
+
+	switch ( fuzz_u8(_in) % 14 ) {
+	case 0: {
+		const u64 n = fuzz_payload(_in, buf, FUZZ_MAX_PAYLOAD);
+		FUZZ_CHECK(SS.append_n(_string, buf, n) == (len + n <= Stack_Size - 1));
+		if (len + n <= Stack_Size - 1) ref_insert(_ref, len, buf, n);
+		break;
+	}
+	case 1: {
+		const u64 n = fuzz_cstr(_in, buf, FUZZ_MAX_PAYLOAD);
+		FUZZ_CHECK(SS.append(_string, buf) == (len + n <= Stack_Size - 1));
+		if (len + n <= Stack_Size - 1) ref_insert(_ref, len, buf, n);
+		break;
+	}
+	case 2: {
+		const u64 n = fuzz_cstr(_in, buf, 12);
+		const bool valid = start <= len && len + n <= Stack_Size - 1;
+		FUZZ_CHECK(SS.insert(_string, buf, start) == valid);
+		if (valid) ref_insert(_ref, start, buf, n);
+		break;
+	}
+	case 3: {
+		const bool valid = start <= end && end <= len;
+		FUZZ_CHECK(SS.slice(_string, start, end) == valid);
+		if (valid) {
+			memmove(_ref->data, _ref->data + start, end - start);
+			_ref->len = end - start;
+		}
+		break;
+	}
+	case 4: {
+		const bool valid = start <= end && end <= len;
+		const Optional(SS_t) sliced = SS.owned_slice(_string, start, end);
+		FUZZ_CHECK(IsSome_owned(sliced) == valid);
+		if (valid) {
+			Fuzz_ref expected = { .len = (u64)(end - start) };
+			memcpy(expected.data, _ref->data + start, end - start);
+			check_ss(&sliced.contents, &expected);
+		}
+		break;
+	}
+	case 5: {
+		const char* at = SS.at(_string, start);
+		FUZZ_CHECK((at != NULL) == (start < len));
+		if (at) FUZZ_CHECK(*at == _ref->data[start]);
+		FUZZ_CHECK(SS.end(_string) == _string->data + len);
+		break;
+	}
+	case 6: {
+		u64 n = fuzz_cstr(_in, buf, 3);
+		if (n == 0) buf[n++] = 'a', buf[n] = '\0';
+		const Optional(u16) found = SS.find(_string, buf);
+		const i64 expected = ref_find(_ref->data, len, buf, n);
+		FUZZ_CHECK(IsSome_owned(found) == (expected >= 0));
+		if (expected >= 0) FUZZ_CHECK(found.contents == (u64)expected);
+		break;
+	}
+	case 7: {
+		fuzz_cstr(_in, buf, 3);
+		FUZZ_CHECK(SS.strip(_string, buf));
+		u64 kept = 0;
+		for ( u64 idx = 0; idx < len; ++idx )
+			if (_ref->data[idx] == '\0' || !strchr(buf, _ref->data[idx])) _ref->data[kept++] = _ref->data[idx];
+		_ref->len = kept;
+		break;
+	}
+	case 8: {
+		FUZZ_CHECK(SS.toupper(_string));
+		for ( u64 idx = 0; idx < len; ++idx ) if (_ref->data[idx] >= 'a' && _ref->data[idx] <= 'z') _ref->data[idx] -= 32;
+		break;
+	}
+	case 9: {
+		FUZZ_CHECK(SS.tolower(_string));
+		for ( u64 idx = 0; idx < len; ++idx ) if (_ref->data[idx] >= 'A' && _ref->data[idx] <= 'Z') _ref->data[idx] += 32;
+		break;
+	}
+	case 10: {
+		const u64 n = fuzz_cstr(_in, buf, 3);
+		if (n == 0) break;
+		FUZZ_CHECK(StackString_remove(_string, buf));
+		char out[Stack_Size];
+		u64 kept = 0;
+		for ( u64 idx = 0; idx < len; ) {
+			if (idx + n <= len && memcmp(_ref->data + idx, buf, n) == 0) {
+				idx += n;
+				continue;
+			}
+			out[kept++] = _ref->data[idx++];
+		}
+		memcpy(_ref->data, out, kept);
+		_ref->len = kept;
+		break;
+	}
+	case 11: {
+		const char c = (char)fuzz_u8(_in);
+		FUZZ_CHECK(SS.replace(_string, c, start) == (start < len));
+		if (start < len) _ref->data[start] = c;
+		break;
+	}
+	case 12: {
+		SS_t other = SS.owned_from("").contents;
+		const u64 n = fuzz_payload(_in, buf, Stack_Size - 1);
+		const u64 shared_len = (n < len) ? n : len;
+		if (fuzz_u8(_in) & 1) memcpy(buf, _ref->data, shared_len);
+		FUZZ_CHECK(SS.append_n(&other, buf, n));
+		FUZZ_CHECK(sign(SS.cmp(_string, &other)) == sign(ref_cmp(_ref->data, len, buf, n)));
+		FUZZ_CHECK(sign(SS.cmp(&other, _string)) == sign(ref_cmp(buf, n, _ref->data, len)));
+		FUZZ_CHECK(SS.eq(_string, &other) == (n == len && memcmp(buf, _ref->data, n) == 0));
+		break;
+	}
+	case 13: {
+		char* copy = SS.owned_cstr(_string);
+		FUZZ_CHECK(copy && memcmp(copy, _ref->data, len) == 0 && copy[len] == '\0');
+		free(copy);
+		if (fuzz_u8(_in) & 1) {
+			FUZZ_CHECK(SS.clear(_string));
+			_ref->len = 0;
+		}
+		break;
+	}
+	}
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* _data, size_t _size)
+{
+	Fuzz_in in = { .data = _data, .size = _size, .pos = 0 };
+	static Fuzz_ref ref;
+	static Fuzz_ref snap_ref;
+	static Fuzz_ref ss_ref;
+	ref.len = 0;
+	ss_ref.len = 0;
+
+	String_t string = String.owned_from_n("", 0).contents;
+	String_t snap;
+	bool has_snap = false;
+	SS_t ss = SS.owned_from("").contents;
+
+	while ( in.pos < in.size ) {
+		if (fuzz_u8(&in) & 1) {
+			fuzz_string_op(&in, &string, &ref, &snap, &snap_ref, &has_snap);
+			check_string(&string, &ref);
+			if (has_snap) check_string(&snap, &snap_ref);
+		}
+		else {
+			fuzz_ss_op(&in, &ss, &ss_ref);
+			check_ss(&ss, &ss_ref);
+		}
+	}
+
+	if (has_snap) String.free_owned(&snap);
+	String.free_owned(&string);
+	return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+#ifndef FUZZ_RUNS
+#define FUZZ_RUNS 20000
+#endif
+
+static int fuzz_replay(const char* _path)
+{
+	FILE* file = fopen(_path, "rb");
+	if (!file) {
+		fprintf(stderr, "cannot open %s\n", _path);
+		return 1;
+	}
+	static u8 input[1 << 16];
+	const size_t size = fread(input, 1, sizeof(input), file);
+	fclose(file);
+	LLVMFuzzerTestOneInput(input, size);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1) {
+		int status = 0;
+		for ( int idx = 1; idx < argc; ++idx ) status |= fuzz_replay(argv[idx]);
+		return status;
+	}
+
+	const char* runs_env = getenv("FUZZ_RUNS");
+	const u64 runs = runs_env ? strtoull(runs_env, NULL, 10) : FUZZ_RUNS;
+	const char* seed_env = getenv("FUZZ_SEED");
+	u64 state = seed_env ? strtoull(seed_env, NULL, 10) | 1 : 0x9E3779B97F4A7C15UL;
+
+	static u8 input[2048];
+	for ( u64 run = 0; run < runs; ++run ) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		const u64 size = state % sizeof(input);
+		for ( u64 idx = 0; idx < size; ++idx ) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			input[idx] = (u8)(state >> 24);
+		}
+		LLVMFuzzerTestOneInput(input, size);
+	}
+	printf("%lu runs ok\n", runs);
+	return 0;
+}
+#endif // End FUZZ_STANDALONE
@@ -0,0 +1,52 @@
+/*
+ | Includes every header and is compiled twice, once with -DLINK_CHECK_MAIN, into one binary
+ | With -DCT_STATIC_DISPATCH every entry point has internal linkage, so the link has to succeed
+ | without multiple definitions and both translation units have to see working tables
+*/
+#include <stdio.h>
+
+#include "../alloc.h"
+#include "../bit_manip.h"
+#include "../generic_string.h"
+#include "../hash.h"
+#include "../instrument.h"
+#include "../number.h"
+#include "../optional.h"
+#include "../par_string.h"
+#include "../ring_buffer.h"
+#include "../stack_string.h"
+#include "../string.h"
+#include "../string_sort.h"
+#include "../thread_pool.h"
+#include "../types.h"
+#include "../utf8.h"
+
+#ifndef LINK_CHECK_MAIN
+u64 link_check_other(void)
+{
+	String_t string = String.owned_from("other").contents;
+	Num.append_u64(&string, 42);
+	const u64 len = UTF8.count(string.data, string.len) + ParString.count(&string, "o");
+	String.free_owned(&string);
+	return len;
+}
+#else
+u64 link_check_other(void);
+
+int main(void)
+{
+	String_t strings[2] = { String.owned_from("b").contents, String.owned_from("a").contents };
+	StringSort.string(strings, 2);
+	const bool ok = String.cmp(&strings[0], &strings[1]) < 0 && link_check_other() == 8;
+	String.free_owned(&strings[0]);
+	String.free_owned(&strings[1]);
+
+	Blk blk = alloc_blk(16);
+	free_blk(&blk);
+	Pool_t* pool = Pool.create(1);
+	Pool.destroy(pool);
+
+	printf("link check %s\n", ok ? "ok" : "failed");
+	return ok ? 0 : 1;
+}
+#endif // End LINK_CHECK_MAIN
@@ -0,0 +1,185 @@
+/*
+ | Stress runs for the work stealing pool in thread_pool.h
+ | parallel_for ranges split and get stolen, tasks nest further parallel_for calls, and several
+ | threads outside the pool submit task groups into it at once, every index must run exactly once
+ | and every leaf range has to respect its grain
+ | The wake rounds park every worker first, then hand out tasks that only finish once all of
+ | them run at the same time, so a lost wakeup hangs the run and the alarm turns that into a failure
+ | Run by `make check` under ASan/UBSan and again under TSan, STRESS_ROUNDS scales the run
+*/
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../thread_pool.h"
+
+#define STRESS_WORKERS 3
+#define STRESS_EXTERNAL 4
+#define STRESS_N 4096
+#define STRESS_INNER 64
+#define STRESS_TIMEOUT 120
+
+static u64 STRESS_ROUNDS = 20;
+static atomic_ulong FAILED;
+
+#define EXPECT(_cond) \
+	do { \
+		if (!(_cond)) { \
+			fprintf(stderr, "%s:%d: %s: expected %s\n", __FILE__, __LINE__, __func__, #_cond); \
+			atomic_fetch_add(&FAILED, 1); \
+		} \
+	} while (0) // End EXPECT
+
+typedef struct Stress_ctx {
+	Pool_t* pool;
+	atomic_uchar* hits;
+	u64 base;
+	u64 grain;
+	u64 inner_grain;
+} Stress_ctx;
+
+static void stress_leaf(void* _ctx, const u64 _begin, const u64 _end)
+{
+	Stress_ctx* ctx = (Stress_ctx*)_ctx;
+	EXPECT(_begin < _end && _end - _begin <= ctx->inner_grain && (_begin % STRESS_INNER) % ctx->inner_grain == 0);
+	for ( u64 idx = _begin; idx < _end; ++idx )
+		EXPECT(atomic_fetch_add_explicit(&ctx->hits[idx], 1, memory_order_relaxed) == 0);
+}
+
+static void stress_outer(void* _ctx, const u64 _begin, const u64 _end)
+/*
+ | Every outer index owns STRESS_INNER hits and covers them with a nested parallel_for
+*/
+{
+	Stress_ctx* ctx = (Stress_ctx*)_ctx;
+	EXPECT(_begin < _end && _end - _begin <= ctx->grain && (_begin - ctx->base) % ctx->grain == 0);
+	for ( u64 idx = _begin; idx < _end; ++idx )
+		EXPECT(Pool.parallel_for(ctx->pool, idx * STRESS_INNER, (idx + 1) * STRESS_INNER, ctx->inner_grain, stress_leaf, ctx));
+}
+
+static void stress_check(atomic_uchar* _hits, const u64 _n)
+{
+	for ( u64 idx = 0; idx < _n; ++idx ) {
+		EXPECT(atomic_load(&_hits[idx]) == 1);
+		atomic_store(&_hits[idx], 0);
+	}
+}
+
+static void nested_run(Pool_t* _pool, atomic_uchar* _hits, const u64 _round)
+{
+	Stress_ctx ctx = {
+		.pool = _pool,
+		.hits = _hits,
+		.base = 0,
+		.grain = 1 + _round % 7,
+		.inner_grain = 1 + _round % 13,
+	};
+	EXPECT(Pool.parallel_for(_pool, 0, STRESS_N / STRESS_INNER, ctx.grain, stress_outer, &ctx));
+	stress_check(_hits, STRESS_N);
+}
+
+typedef struct Stress_external {
+	Pool_t* pool;
+	atomic_uchar* hits;
+	u32 id;
+	u64 round;
+} Stress_external;
+
+static void* external_submit(void* _arg)
+/*
+ | One thread outside the pool, spawns a group of tasks over its own slice of outer indexes
+*/
+{
+	Stress_external* ext = (Stress_external*)_arg;
+	const u64 slice = (STRESS_N / STRESS_INNER) / STRESS_EXTERNAL;
+	Stress_ctx ctx = {
+		.pool = ext->pool,
+		.hits = ext->hits,
+		.base = ext->id * slice,
+		.grain = 1,
+		.inner_grain = 1 + (ext->round + ext->id) % 9,
+	};
+
+	TaskGroup_t group;
+	EXPECT(Pool.group(&group));
+	// one task per outer index, each of them still nests a parallel_for
+	for ( u64 idx = ctx.base; idx < ctx.base + slice; ++idx )
+		EXPECT(Pool.spawn(ext->pool, &group, stress_outer, &ctx, idx, idx + 1));
+	EXPECT(Pool.wait(ext->pool, &group));
+	return NULL;
+}
+
+static void external_run(Pool_t* _pool, atomic_uchar* _hits, const u64 _round)
+{
+	pthread_t threads[STRESS_EXTERNAL];
+	Stress_external ext[STRESS_EXTERNAL];
+	for ( u32 idx = 0; idx < STRESS_EXTERNAL; ++idx ) {
+		ext[idx] = (Stress_external){ .pool = _pool, .hits = _hits, .id = idx, .round = _round };
+		pthread_create(&threads[idx], NULL, external_submit, &ext[idx]);
+	}
+	for ( u32 idx = 0; idx < STRESS_EXTERNAL; ++idx ) pthread_join(threads[idx], NULL);
+	stress_check(_hits, STRESS_N);
+}
+
+static atomic_ulong ARRIVED;
+
+static void wake_task(void* _ctx, const u64 _begin, const u64 _end)
+/*
+ | Returns only once every thread of the pool is inside a wake_task at the same time
+*/
+{
+	(void)_begin;
+	(void)_end;
+	const u64 target = *(const u64*)_ctx;
+	atomic_fetch_add(&ARRIVED, 1);
+	while ( atomic_load(&ARRIVED) < target ) sched_yield();
+}
+
+static void wake_run(Pool_t* _pool, const u64 _round)
+{
+	// long enough for every worker to give up spinning and block on the condition variable
+	usleep(20000);
+
+	const u64 base = _round * (STRESS_WORKERS + 1);
+	const u64 target = base + STRESS_WORKERS + 1;
+	TaskGroup_t group;
+	EXPECT(Pool.group(&group));
+	for ( u32 idx = 0; idx <= STRESS_WORKERS; ++idx ) EXPECT(Pool.spawn(_pool, &group, wake_task, (void*)&target, idx, idx + 1));
+	EXPECT(Pool.wait(_pool, &group));
+	EXPECT(atomic_load(&ARRIVED) == target);
+}
+
+int main(void)
+{
+	const char* rounds = getenv("STRESS_ROUNDS");
+	if (rounds && atol(rounds) > 0) STRESS_ROUNDS = (u64)atol(rounds);
+	alarm(STRESS_TIMEOUT);
+
+	atomic_uchar* hits = (atomic_uchar*)calloc(STRESS_N, sizeof(atomic_uchar));
+	Pool_t* pool = Pool.create(STRESS_WORKERS);
+	EXPECT(hits && pool && Pool.threads(pool) == STRESS_WORKERS + 1);
+	if (!hits || !pool) return 1;
+
+	atomic_init(&ARRIVED, 0);
+	for ( u64 round = 0; round < STRESS_ROUNDS; ++round ) {
+		nested_run(pool, hits, round);
+		external_run(pool, hits, round);
+		wake_run(pool, round);
+	}
+	EXPECT(Pool.destroy(pool));
+
+	// a pool torn down while its workers are still spinning or parked must not hang either
+	for ( u64 round = 0; round < STRESS_ROUNDS; ++round ) {
+		pool = Pool.create(STRESS_WORKERS);
+		EXPECT(pool != NULL);
+		if (round & 1) nested_run(pool, hits, round);
+		EXPECT(Pool.destroy(pool));
+	}
+	free(hits);
+
+	const u64 failed = atomic_load(&FAILED);
+	if (failed) fprintf(stderr, "%lu pool stress check(s) failed\n", failed);
+	return failed ? 1 : 0;
+}
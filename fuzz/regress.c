@@ -0,0 +1,265 @@
+/*
+ | Regression cases for bugs the fuzzer or review turned up, each one a minimal reproducer
+ | Run by `make check` in every build mode with ASan and UBSan, a failing case exits non zero
+*/
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../string.h"
+#include "../stack_string.h"
+#include "../string_sort.h"
+#include "../number.h"
+#include "../par_string.h"
+
+static u64 FAILED = 0;
+
+#define EXPECT(_cond) \
+	do { \
+		if (!(_cond)) { \
+			fprintf(stderr, "%s:%d: %s: expected %s\n", __FILE__, __LINE__, __func__, #_cond); \
+			++FAILED; \
+		} \
+	} while (0) // End EXPECT
+
+#define EXPECT_STR(_string, _bytes, _len) \
+	EXPECT((_string)->len == (_len) && memcmp((_string)->data, (_bytes), (_len)) == 0 && (_string)->data[(_len)] == '\0') // End EXPECT_STR
+
+static String_t tight(const char* _bytes, const u64 _len)
+{
+	// no spare capacity, so the next growth has to realloc and move the buffer
+	String_t string = String.owned_from_n(_bytes, _len).contents;
+	String.shrink(&string);
+	return string;
+}
+
+static void append_str_self(void)
+{
+	String_t string = tight("abcdef", 6);
+	EXPECT(String.append_str(&string, &string));
+	EXPECT_STR(&string, "abcdefabcdef", 12);
+	String.free_owned(&string);
+}
+
+static void append_n_interior(void)
+{
+	String_t string = tight("abcdef", 6);
+	EXPECT(String.append_n(&string, string.data + 2, 3));
+	EXPECT_STR(&string, "abcdefcde", 9);
+	EXPECT(String.append(&string, string.data + 7));
+	EXPECT_STR(&string, "abcdefcdede", 11);
+	String.free_owned(&string);
+}
+
+static void append_str_shared(void)
+{
+	// under CT_STRING_COW make_unique moves string off the shared buffer before it grows
+	String_t string = tight("abcdef", 6);
+	String_t shared = String.share(&string).contents;
+	EXPECT(String.append_n(&string, string.data + 1, 4));
+	EXPECT_STR(&string, "abcdefbcde", 10);
+	EXPECT_STR(&shared, "abcdef", 6);
+	EXPECT(String.append_str(&shared, &shared));
+	EXPECT_STR(&shared, "abcdefabcdef", 12);
+	String.free_owned(&shared);
+	String.free_owned(&string);
+}
+
+static void insert_str_self(void)
+{
+	const char* bytes = "abcdef";
+	for ( u64 idx = 0; idx <= 6; ++idx ) {
+		String_t string = tight(bytes, 6);
+		char expected[12];
+		memcpy(expected, bytes, idx);
+		memcpy(expected + idx, bytes, 6);
+		memcpy(expected + idx + 6, bytes + idx, 6 - idx);
+		EXPECT(String.insert_str(&string, &string, idx));
+		EXPECT_STR(&string, expected, 12);
+		String.free_owned(&string);
+	}
+}
+
+static void insert_n_overlapping_tail(void)
+{
+	// every source range inside the string, before, straddling and past the insertion point
+	const char* bytes = "0123456789";
+	for ( u64 start = 0; start < 10; ++start )
+		for ( u64 len = 0; start + len <= 10; ++len )
+			for ( u64 idx = 0; idx <= 10; ++idx ) {
+				String_t string = tight(bytes, 10);
+				char expected[20];
+				memcpy(expected, bytes, idx);
+				memcpy(expected + idx, bytes + start, len);
+				memcpy(expected + idx + len, bytes + idx, 10 - idx);
+				EXPECT(String.insert_n(&string, string.data + start, len, idx));
+				EXPECT_STR(&string, expected, 10 + len);
+				String.free_owned(&string);
+			}
+
+	// with spare capacity nothing moves and only the memmove can clobber the source
+	String_t string = String.owned_from_n("abcdef", 6).contents;
+	String.resize(&string, 64);
+	EXPECT(String.insert_n(&string, string.data + 1, 4, 2));
+	EXPECT_STR(&string, "abbcdecdef", 10);
+	String.free_owned(&string);
+}
+
+static void sort_long_shared_prefix(void)
+{
+	// a 2 MiB shared prefix used to cost one stack frame per 8 bytes
+	const u64 prefix = 2 << 20;
+	const u64 n = 16;
+	char* bytes = (char*)malloc(prefix + 2);
+	memset(bytes, 'p', prefix);
+	String_t strings[16];
+	for ( u64 idx = 0; idx < n; ++idx ) {
+		// tails in reverse order, and every other string also runs past the cap before it differs
+		bytes[prefix] = (char)('z' - idx / 2);
+		bytes[prefix + 1] = (char)('0' + idx % 2);
+		strings[idx] = String.owned_from_n(bytes, prefix + 1 + (idx % 2)).contents;
+	}
+	EXPECT(StringSort.string(strings, n));
+	for ( u64 idx = 1; idx < n; ++idx ) EXPECT(String.cmp(&strings[idx-1], &strings[idx]) < 0);
+	for ( u64 idx = 0; idx < n; ++idx ) String.free_owned(&strings[idx]);
+	free(bytes);
+}
+
+static void replace_all_self_pattern(void)
+{
+	// the in-place compaction used to overwrite the needle it was still searching for
+	String_t string = tight("xab-ab-ab-ab", 12);
+	EXPECT(String.replace_all_n(&string, string.data + 1, 2, "", 0));
+	EXPECT_STR(&string, "x---", 4);
+	String.free_owned(&string);
+
+	string = tight("abXabXab", 8);
+	EXPECT(String.replace_all_n(&string, "ab", 2, string.data + 2, 1));
+	EXPECT_STR(&string, "XXXXX", 5);
+	String.free_owned(&string);
+
+	// past STRING_PATTERN_BUF the copy goes to the heap
+	char bytes[3 * 100 + 2];
+	memset(bytes, 'n', sizeof(bytes));
+	bytes[100] = bytes[201] = '|';
+	string = tight(bytes, sizeof(bytes));
+	EXPECT(String.remove_all(&string, "|") && string.len == 300);
+	EXPECT(String.replace_all_n(&string, string.data, 100, string.data + 100, 0));
+	EXPECT(string.len == 0);
+	String.free_owned(&string);
+}
+
+static void replace_all_no_match_keeps_share(void)
+{
+	// without a match the single byte path must not unshare the buffer under CT_STRING_COW
+	String_t string = tight("abcdef", 6);
+	String_t shared = String.share(&string).contents;
+	const u64 refs = String.refs(&string);
+	const char* data = string.data;
+	EXPECT(!String.replace_all_n(&string, "z", 1, "y", 1));
+	EXPECT(!String.remove_all(&string, "z"));
+	EXPECT(String.refs(&string) == refs && string.data == data);
+	EXPECT(String.replace_all_n(&string, "c", 1, "", 0));
+	EXPECT_STR(&string, "abdef", 5);
+	EXPECT_STR(&shared, "abcdef", 6);
+	String.free_owned(&shared);
+	String.free_owned(&string);
+}
+
+static void append_f64_subnormal(void)
+{
+	// subnormals need fewer than 15 digits, the printf search used to start at 15 for them too
+	String_t string = String.owned_from_n("", 0).contents;
+	EXPECT(Num.append_f64(&string, DBL_TRUE_MIN));
+	EXPECT_STR(&string, "5e-324", 6);
+	String.clear(&string);
+	EXPECT(Num.append_f64(&string, 3 * DBL_TRUE_MIN));
+	EXPECT_STR(&string, "1.5e-323", 8);
+	String.clear(&string);
+	EXPECT(Num.append_f64(&string, 0.1));
+	EXPECT_STR(&string, "0.1", 3);
+
+	// every formatted subnormal still parses back to itself
+	for ( d64 val = DBL_TRUE_MIN; val < DBL_MIN; val *= 1.7 ) {
+		String.clear(&string);
+		EXPECT(Num.append_f64(&string, val));
+		const Optional(d64) parsed = Num.to_f64(string.data, string.len);
+		EXPECT(IsSome_owned(parsed) && parsed.contents == val);
+	}
+	String.free_owned(&string);
+}
+
+static void instrument_outermost_scope(void)
+{
+	// String.append grows through String.resize and String.make_unique, which used to open scopes
+	// of their own and take every realloc away from the call the user actually made
+	if (!Inst.enabled()) return;
+	String_t string = String.owned_from_n("", 0).contents;
+	Inst.reset();
+	for ( u64 idx = 0; idx < 1000; ++idx ) EXPECT(String.append(&string, "x"));
+
+	const Optional(Inst_stats_t) append = Inst.stats("String.append");
+	EXPECT(IsSome_owned(append) && append.contents.calls == 1000);
+	EXPECT(IsSome_owned(append) && append.contents.allocs + append.contents.reallocs > 0);
+	const Optional(Inst_stats_t) resize = Inst.stats("String.resize");
+	EXPECT(!IsSome_owned(resize) || (resize.contents.calls == 0 && resize.contents.reallocs == 0));
+	const Optional(Inst_stats_t) unique = Inst.stats("String.make_unique");
+	EXPECT(!IsSome_owned(unique) || unique.contents.calls == 0);
+	String.free_owned(&string);
+}
+
+static void par_count_periodic(void)
+{
+	// in a run of 'a' every chunk starts inside a match of "aaa" carried over from the one before,
+	// and the chains each chunk keeps have to agree with a plain left to right scan
+	const u64 len = 4 * PAR_STRING_CHUNK + 7;
+	char* text = (char*)malloc(len + 1);
+	memset(text, 'a', len);
+	text[len] = '\0';
+	// a few breaks, so chains fold on some chunks and stay apart on others
+	text[PAR_STRING_CHUNK + 1000] = 'b';
+	text[3 * PAR_STRING_CHUNK - 2] = 'b';
+	const String_t view = { .data = text, .size = len + 1, .len = len };
+
+	Pool_t* pool = Pool.create(1);
+	ParString.set_pool(pool);
+	ParString.set_threshold(0);
+	static const char* const needles[] = { "aa", "aaa", "aaaaa", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", "ab", "aab" };
+	for ( u64 idx = 0; idx < sizeof(needles) / sizeof(needles[0]); ++idx ) {
+		const u64 needle_len = strlen(needles[idx]);
+		EXPECT(ParString.count(&view, needles[idx]) == string_count(text, len, needles[idx], needle_len));
+
+		String_t parallel = String.owned_from_n(text, len).contents;
+		String_t serial = String.owned_from_n(text, len).contents;
+		EXPECT(ParString.remove(&parallel, needles[idx]) == String.remove(&serial, needles[idx]));
+		EXPECT_STR(&parallel, serial.data, serial.len);
+		String.free_owned(&parallel);
+		String.free_owned(&serial);
+	}
+	ParString.set_threshold(PAR_STRING_THRESHOLD);
+	ParString.set_pool(NULL);
+	Pool.destroy(pool);
+	free(text);
+}
+
+static void (*const CASES[])(void) = {
+	append_str_self,
+	append_n_interior,
+	append_str_shared,
+	insert_str_self,
+	insert_n_overlapping_tail,
+	sort_long_shared_prefix,
+	replace_all_self_pattern,
+	replace_all_no_match_keeps_share,
+	append_f64_subnormal,
+	instrument_outermost_scope,
+	par_count_periodic,
+};
+
+int main(void)
+{
+	for ( u64 idx = 0; idx < sizeof(CASES) / sizeof(CASES[0]); ++idx ) CASES[idx]();
+	if (FAILED) fprintf(stderr, "%lu regression check(s) failed\n", FAILED);
+	return FAILED ? 1 : 0;
+}
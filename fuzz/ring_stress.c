@@ -0,0 +1,225 @@
+/*
+ | Producer / consumer stress runs for the SPSC and MPMC rings in ring_buffer.h
+ | Every value carries its producer and sequence number: consumers check that each producer's
+ | values arrive in order, and at the end every value must have been popped exactly once
+ | The rings are kept small so their indexes wrap thousands of times, and single and batched
+ | pushes and pops are mixed so both paths cross the wrap point
+ | Run by `make check` under ASan/UBSan and again under TSan, STRESS_N sets the values per producer
+ | A ring that loses a value livelocks instead of failing, so an alarm ends runs that hang
+*/
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../ring_buffer.h"
+
+#define STRESS_CAPACITY 64
+#define STRESS_BATCH 8
+#define STRESS_PRODUCERS 3
+#define STRESS_CONSUMERS 3
+#define STRESS_TIMEOUT 120
+
+static u64 STRESS_N = 50000;
+static atomic_ulong FAILED;
+
+#define EXPECT(_cond) \
+	do { \
+		if (!(_cond)) { \
+			fprintf(stderr, "%s:%d: %s: expected %s\n", __FILE__, __LINE__, __func__, #_cond); \
+			atomic_fetch_add(&FAILED, 1); \
+		} \
+	} while (0) // End EXPECT
+
+// a value is its producer in the top bits and its sequence number below
+#define STRESS_VALUE(_producer, _seq) (((u64)(_producer) << 40) | (_seq))
+#define STRESS_PRODUCER(_val) ((_val) >> 40)
+#define STRESS_SEQ(_val) ((_val) & ((1UL << 40) - 1))
+
+static u64 stress_batch(const u64 _next)
+{
+	const u64 want = 1 + _next % STRESS_BATCH;
+	return (want < STRESS_N - _next) ? want : STRESS_N - _next;
+}
+
+typedef struct Stress_mpmc {
+	MPMC(u64)* ring;
+	MPMC(String_ptr)* strings;
+	u32 producer;
+
+	// one counter per value, bumped by whichever consumer pops it
+	atomic_uchar* seen;
+	atomic_ulong popped;
+} Stress_mpmc;
+
+static void stress_seen(Stress_mpmc* _ctx, const u64 _val, u64* _next)
+/*
+ | Checks _val against the consumer's next expected sequence per producer in _next
+*/
+{
+	const u64 producer = STRESS_PRODUCER(_val);
+	const u64 seq = STRESS_SEQ(_val);
+	if (producer >= STRESS_PRODUCERS || seq >= STRESS_N) {
+		EXPECT(producer < STRESS_PRODUCERS && seq < STRESS_N);
+		return;
+	}
+	// a single producer's cells are claimed in order, so any one consumer sees them in order
+	EXPECT(seq >= _next[producer]);
+	_next[producer] = seq + 1;
+	EXPECT(atomic_fetch_add_explicit(&_ctx->seen[producer * STRESS_N + seq], 1, memory_order_relaxed) == 0);
+}
+
+static void* spsc_producer(void* _ring)
+{
+	SPSC(u64)* ring = (SPSC(u64)*)_ring;
+	u64 vals[STRESS_BATCH];
+	for ( u64 next = 0; next < STRESS_N; ) {
+		const u64 n = stress_batch(next);
+		for ( u64 idx = 0; idx < n; ++idx ) vals[idx] = next + idx;
+		const u64 pushed = (n == 1) ? SPSC_fn(u64, push)(ring, vals) : SPSC_fn(u64, push_n)(ring, vals, n);
+		if (!pushed) sched_yield();
+		next += pushed;
+	}
+	return NULL;
+}
+
+static void spsc_run(void)
+{
+	SPSC(u64)* ring = SPSC_fn(u64, create)(STRESS_CAPACITY);
+	EXPECT(ring != NULL);
+	if (!ring) return;
+
+	pthread_t producer;
+	pthread_create(&producer, NULL, spsc_producer, ring);
+
+	u64 vals[STRESS_BATCH];
+	for ( u64 expect = 0; expect < STRESS_N; ) {
+		const u64 want = 1 + (expect / 3) % STRESS_BATCH;
+		const u64 n = (want == 1) ? SPSC_fn(u64, pop)(ring, vals) : SPSC_fn(u64, pop_n)(ring, vals, want);
+		if (!n) sched_yield();
+		for ( u64 idx = 0; idx < n; ++idx, ++expect ) {
+			if (vals[idx] == expect) continue;
+			EXPECT(vals[idx] == expect);
+			expect = vals[idx];
+		}
+	}
+	pthread_join(producer, NULL);
+
+	EXPECT(SPSC_fn(u64, len)(ring) == 0);
+	EXPECT(SPSC_fn(u64, pop)(ring, vals) == false);
+	SPSC_fn(u64, free)(ring);
+}
+
+static void* mpmc_producer(void* _ctx)
+{
+	Stress_mpmc* ctx = (Stress_mpmc*)_ctx;
+	const u32 producer = ctx->producer;
+	u64 vals[STRESS_BATCH];
+	for ( u64 next = 0; next < STRESS_N; ) {
+		const u64 n = stress_batch(next);
+		for ( u64 idx = 0; idx < n; ++idx ) vals[idx] = STRESS_VALUE(producer, next + idx);
+		const u64 pushed = (n == 1) ? MPMC_fn(u64, push)(ctx->ring, vals) : MPMC_fn(u64, push_n)(ctx->ring, vals, n);
+		if (!pushed) sched_yield();
+		next += pushed;
+	}
+	return NULL;
+}
+
+static void* mpmc_consumer(void* _ctx)
+{
+	Stress_mpmc* ctx = (Stress_mpmc*)_ctx;
+	u64 next[STRESS_PRODUCERS] = { 0 };
+	u64 vals[STRESS_BATCH];
+	for ( u64 round = 0; atomic_load(&ctx->popped) < STRESS_PRODUCERS * STRESS_N; ++round ) {
+		const u64 want = 1 + round % STRESS_BATCH;
+		const u64 n = (want == 1) ? MPMC_fn(u64, pop)(ctx->ring, vals) : MPMC_fn(u64, pop_n)(ctx->ring, vals, want);
+		if (!n) sched_yield();
+		for ( u64 idx = 0; idx < n; ++idx ) stress_seen(ctx, vals[idx], next);
+		atomic_fetch_add(&ctx->popped, n);
+	}
+	return NULL;
+}
+
+static void* mpmc_string_producer(void* _ctx)
+{
+	Stress_mpmc* ctx = (Stress_mpmc*)_ctx;
+	const u32 producer = ctx->producer;
+	for ( u64 seq = 0; seq < STRESS_N; ++seq ) {
+		// ownership moves through the ring, the consumer reads the bytes back and frees it
+		const u64 val = STRESS_VALUE(producer, seq);
+		String_ptr string = String.from_n((const char*)&val, sizeof(u64));
+		EXPECT(string != NULL);
+		while ( !MPMC_fn(String_ptr, push)(ctx->strings, &string) ) sched_yield();
+	}
+	return NULL;
+}
+
+static void* mpmc_string_consumer(void* _ctx)
+{
+	Stress_mpmc* ctx = (Stress_mpmc*)_ctx;
+	u64 next[STRESS_PRODUCERS] = { 0 };
+	while ( atomic_load(&ctx->popped) < STRESS_PRODUCERS * STRESS_N ) {
+		String_ptr string;
+		if (!MPMC_fn(String_ptr, pop)(ctx->strings, &string)) {
+			sched_yield();
+			continue;
+		}
+		EXPECT(string->len == sizeof(u64));
+		u64 val;
+		memcpy(&val, string->data, sizeof(u64));
+		String.free(string);
+		stress_seen(ctx, val, next);
+		atomic_fetch_add(&ctx->popped, 1);
+	}
+	return NULL;
+}
+
+static void mpmc_run(const bool _strings)
+{
+	Stress_mpmc ctx[STRESS_PRODUCERS];
+	MPMC(u64)* ring = _strings ? NULL : MPMC_fn(u64, create)(STRESS_CAPACITY);
+	MPMC(String_ptr)* strings = _strings ? MPMC_fn(String_ptr, create)(STRESS_CAPACITY) : NULL;
+	atomic_uchar* seen = (atomic_uchar*)calloc(STRESS_PRODUCERS * STRESS_N, sizeof(atomic_uchar));
+	EXPECT((ring || strings) && seen);
+	if (!(ring || strings) || !seen) return;
+
+	// producers each get a copy carrying their index, consumers all work on the shared one
+	Stress_mpmc shared = { .ring = ring, .strings = strings, .seen = seen };
+	atomic_init(&shared.popped, 0);
+
+	pthread_t threads[STRESS_PRODUCERS + STRESS_CONSUMERS];
+	for ( u32 idx = 0; idx < STRESS_PRODUCERS; ++idx ) {
+		memcpy(&ctx[idx], &shared, sizeof(Stress_mpmc));
+		ctx[idx].producer = idx;
+		pthread_create(&threads[idx], NULL, _strings ? mpmc_string_producer : mpmc_producer, &ctx[idx]);
+	}
+	for ( u32 idx = 0; idx < STRESS_CONSUMERS; ++idx )
+		pthread_create(&threads[STRESS_PRODUCERS + idx], NULL, _strings ? mpmc_string_consumer : mpmc_consumer, &shared);
+	for ( u32 idx = 0; idx < STRESS_PRODUCERS + STRESS_CONSUMERS; ++idx ) pthread_join(threads[idx], NULL);
+
+	EXPECT(atomic_load(&shared.popped) == STRESS_PRODUCERS * STRESS_N);
+	for ( u64 idx = 0; idx < STRESS_PRODUCERS * STRESS_N; ++idx ) EXPECT(atomic_load(&seen[idx]) == 1);
+
+	u64 val;
+	String_ptr string;
+	EXPECT(_strings ? !MPMC_fn(String_ptr, pop)(strings, &string) : !MPMC_fn(u64, pop)(ring, &val));
+	MPMC_fn(u64, free)(ring);
+	MPMC_fn(String_ptr, free)(strings);
+	free(seen);
+}
+
+int main(void)
+{
+	const char* n = getenv("STRESS_N");
+	if (n && atol(n) > 0) STRESS_N = (u64)atol(n);
+	alarm(STRESS_TIMEOUT);
+
+	spsc_run();
+	mpmc_run(false);
+	mpmc_run(true);
+
+	const u64 failed = atomic_load(&FAILED);
+	if (failed) fprintf(stderr, "%lu ring stress check(s) failed\n", failed);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,91 @@
+#ifndef _CT_STL_GENERIC_STRING_H
+#define _CT_STL_GENERIC_STRING_H
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "string.h"
+#include "stack_string.h"
+#include "hash.h"
+#include "optional.h"
+#include "types.h"
+
+/*
+ | Type generic front end over String_t*, SS_t* and C strings
+ | Every argument is first turned into a (pointer, length) view at compile time, so a String_t
+ | or SS_t never pays a strlen, and the strlen of a literal is folded once the tiny static inline
+ | view constructor is inlined into the call site
+ |
+ | str_append(dst, src)	dst is a String_t* or SS_t*, src is any of the supported types
+ | str_find(hay, needle)	Optional(u64) byte offset of the first match
+ | str_eq(a, b)			true when both hold the same bytes
+ | str_hash(x)			FNV-1a of the bytes, equal to HASH_LIT for the same literal
+*/
+
+typedef struct Str_view_t {
+	const char* data;
+	u64 len;
+} Str_view_t;
+
+static inline Str_view_t str_view_string(const String_t* restrict _string)
+{
+	return (Str_view_t){ _string->data, _string->len };
+}
+
+static inline Str_view_t str_view_ss(const SS_t* restrict _string)
+{
+	return (Str_view_t){ _string->data, StackString_len(_string) };
+}
+
+static inline Str_view_t str_view_cstr(const char* restrict _str)
+{
+	return (Str_view_t){ _str, strlen(_str) };
+}
+
+#define str_view(_x) _Generic((_x), \
+	String_t*: str_view_string, \
+	const String_t*: str_view_string, \
+	SS_t*: str_view_ss, \
+	const SS_t*: str_view_ss, \
+	char*: str_view_cstr, \
+	const char*: str_view_cstr \
+	)(_x)
+
+static inline const bool str_append_string(String_t* restrict _dst, const Str_view_t _src)
+{
+	return String_append_n(_dst, _src.data, _src.len);
+}
+
+static inline const bool str_append_ss(SS_t* restrict _dst, const Str_view_t _src)
+{
+	return StackString_append_n(_dst, _src.data, _src.len);
+}
+
+static inline Optional(u64) str_find_view(const Str_view_t _haystack, const Str_view_t _needle)
+{
+	const char* match = string_memfind(_haystack.data, _haystack.len, _needle.data, _needle.len);
+	return match ? Some(u64, (u64)(match - _haystack.data)) : None(u64);
+}
+
+static inline const bool str_eq_view(const Str_view_t _a, const Str_view_t _b)
+{
+	return _a.len == _b.len && (_a.data == _b.data || memcmp(_a.data, _b.data, _a.len) == 0);
+}
+
+static inline u64 str_hash_view(const Str_view_t _view)
+{
+	return hash_fnv1a(_view.data, _view.len);
+}
+
+#define str_append(_dst, _src) _Generic((_dst), \
+	String_t*: str_append_string, \
+	SS_t*: str_append_ss \
+	)((_dst), str_view(_src))
+
+#define str_find(_haystack, _needle) str_find_view(str_view(_haystack), str_view(_needle))
+
+#define str_eq(_a, _b) str_eq_view(str_view(_a), str_view(_b))
+
+#define str_hash(_x) str_hash_view(str_view(_x))
+
+#endif // End _CT_STL_GENERIC_STRING_H
@@ -0,0 +1,52 @@
+#ifndef _CT_STL_HASH_H
+#define _CT_STL_HASH_H
+
+#include "types.h"
+
+/*
+ | 64 bit FNV-1a, usable at runtime and on string literals at compile time
+ | HASH_LIT unrolls the hash over the literal's bytes with every step written so its input only
+ | appears once, for literals of up to HASH_LIT_MAX bytes the compiler folds it into a constant,
+ | including in static initializers
+ | Longer literals fall back to a hash_fnv1a call: same value, but not a constant expression,
+ | so they cannot initialize static storage and hash at runtime wherever they appear
+*/
+
+#define FNV_OFFSET 0xcbf29ce484222325UL
+#define FNV_PRIME 0x100000001b3UL
+
+// the unrolling below covers exactly this many bytes
+#define HASH_LIT_MAX 64
+
+static inline u64 hash_fnv1a(const void* restrict _data, const u64 _len)
+{
+	const u8* bytes = (const u8*)_data;
+	u64 hash = FNV_OFFSET;
+	for ( u64 idx = 0; idx < _len; ++idx ) {
+		hash ^= bytes[idx];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+// past the end of the literal a step xors in 0 and multiplies by 1, so it is a no-op
+#define HASH_LIT_STEP(_s, _i, _h) \
+	(((_h) ^ (u64)(u8)(((_i) < sizeof(_s) - 1) ? (_s)[((_i) < sizeof(_s)) ? (_i) : 0] : 0)) \
+		* (((_i) < sizeof(_s) - 1) ? FNV_PRIME : 1))
+// End HASH_LIT_STEP
+
+#define HASH_LIT_STEP4(_s, _i, _h) \
+	HASH_LIT_STEP(_s, (_i)+3, HASH_LIT_STEP(_s, (_i)+2, HASH_LIT_STEP(_s, (_i)+1, HASH_LIT_STEP(_s, (_i), _h))))
+// End HASH_LIT_STEP4
+
+#define HASH_LIT_STEP16(_s, _i, _h) \
+	HASH_LIT_STEP4(_s, (_i)+12, HASH_LIT_STEP4(_s, (_i)+8, HASH_LIT_STEP4(_s, (_i)+4, HASH_LIT_STEP4(_s, (_i), _h))))
+// End HASH_LIT_STEP16
+
+#define HASH_LIT(_s) \
+	((sizeof("" _s "") - 1 <= HASH_LIT_MAX) \
+		? HASH_LIT_STEP16(_s, 48, HASH_LIT_STEP16(_s, 32, HASH_LIT_STEP16(_s, 16, HASH_LIT_STEP16(_s, 0, FNV_OFFSET)))) \
+		: hash_fnv1a((_s), sizeof(_s) - 1))
+// End HASH_LIT
+
+#endif // End _CT_STL_HASH_H
@@ -0,0 +1,369 @@
+#ifndef _CT_STL_INSTRUMENT_H
+#define _CT_STL_INSTRUMENT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "optional.h"
+#include "types.h"
+
+/*
+ | Opt-in allocation and hot path instrumentation, enabled by building with -DCT_INSTRUMENT
+ | Entry points open a scope with CT_INSTRUMENT_FN, allocations and copies made while a scope is
+ | open are charged to it, and the scope's duration lands in a log2 histogram of timer ticks
+ | Only the outermost scope on a thread counts: an instrumented function called from another one,
+ | e.g. String.resize under String.append, opens no scope of its own, so its calls, time and
+ | allocations all land on the public entry point the caller actually used
+ | Without the flag every macro collapses to the plain libc call or to nothing
+*/
+
+#define INST_BUCKETS 32
+
+typedef struct Inst_stats_t {
+	const char* name;
+	u64 calls;
+	u64 allocs;
+	u64 alloc_bytes;
+	u64 reallocs;
+	u64 realloc_bytes;
+	u64 realloc_moves;
+	u64 frees;
+	u64 copy_bytes;
+	u64 ticks;
+	u64 ticks_max;
+	u64 hist[INST_BUCKETS];
+} Inst_stats_t;
+
+Optional_t(Inst_stats_t);
+
+#ifdef CT_INSTRUMENT
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define INST_TICK_UNIT "cycles"
+#else
+#define INST_TICK_UNIT "ns"
+#endif
+
+typedef struct Inst_site_t {
+	const char* name;
+	struct Inst_site_t* next;
+	atomic_bool registered;
+
+	atomic_ulong calls;
+	atomic_ulong allocs;
+	atomic_ulong alloc_bytes;
+	atomic_ulong reallocs;
+	atomic_ulong realloc_bytes;
+	atomic_ulong realloc_moves;
+	atomic_ulong frees;
+	atomic_ulong copy_bytes;
+	atomic_ulong ticks;
+	atomic_ulong ticks_max;
+	atomic_ulong hist[INST_BUCKETS];
+} Inst_site_t;
+
+typedef struct Inst_scope_t {
+	Inst_site_t* site;
+	u64 start;
+} Inst_scope_t;
+
+// work done outside of any instrumented entry point, e.g. alloc_blk called directly
+static Inst_site_t INST_UNSCOPED = { .name = "(unscoped)" };
+
+static _Atomic(Inst_site_t*) INST_SITES = NULL;
+static _Thread_local Inst_site_t* INST_CURRENT = NULL;
+
+static inline u64 inst_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (u64)now.tv_sec * 1000000000UL + (u64)now.tv_nsec;
+#endif
+}
+
+static void inst_register(Inst_site_t* restrict _site)
+/*
+ | Pushes a site onto the global list the first time it is entered, lock free
+*/
+{
+	bool expected = false;
+	if (!atomic_compare_exchange_strong(&_site->registered, &expected, true)) return;
+
+	Inst_site_t* head = atomic_load_explicit(&INST_SITES, memory_order_relaxed);
+	do {
+		_site->next = head;
+	} while ( !atomic_compare_exchange_weak_explicit(&INST_SITES, &head, _site, memory_order_release, memory_order_relaxed) );
+}
+
+static inline Inst_site_t* inst_current(void)
+{
+	Inst_site_t* site = INST_CURRENT;
+	if (site) return site;
+	if (!atomic_load_explicit(&INST_UNSCOPED.registered, memory_order_relaxed)) inst_register(&INST_UNSCOPED);
+	return &INST_UNSCOPED;
+}
+
+static inline Inst_scope_t inst_enter(Inst_site_t* restrict _site)
+{
+	// nested under another scope, the outer one keeps the charges and this call is not counted
+	if (INST_CURRENT) return (Inst_scope_t){ .site = NULL };
+	if (!atomic_load_explicit(&_site->registered, memory_order_relaxed)) inst_register(_site);
+	atomic_fetch_add_explicit(&_site->calls, 1, memory_order_relaxed);
+
+	Inst_scope_t scope = { .site = _site };
+	INST_CURRENT = _site;
+	scope.start = inst_ticks();
+	return scope;
+}
+
+static inline void inst_leave(Inst_scope_t* restrict _scope)
+{
+	if (!_scope->site) return;
+	const u64 ticks = inst_ticks() - _scope->start;
+	Inst_site_t* site = _scope->site;
+	INST_CURRENT = NULL;
+
+	const u64 bucket = (ticks == 0) ? 0 : 64 - __builtin_clzl(ticks);
+	atomic_fetch_add_explicit(&site->hist[(bucket < INST_BUCKETS) ? bucket : INST_BUCKETS-1], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&site->ticks, ticks, memory_order_relaxed);
+
+	u64 max = atomic_load_explicit(&site->ticks_max, memory_order_relaxed);
+	while ( ticks > max && !atomic_compare_exchange_weak_explicit(&site->ticks_max, &max, ticks, memory_order_relaxed, memory_order_relaxed) )
+		continue;
+}
+
+static inline void* inst_malloc(const u64 _size)
+{
+	Inst_site_t* site = inst_current();
+	atomic_fetch_add_explicit(&site->allocs, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&site->alloc_bytes, _size, memory_order_relaxed);
+	return malloc(_size);
+}
+
+static inline void* inst_calloc(const u64 _amount, const u64 _size)
+{
+	Inst_site_t* site = inst_current();
+	atomic_fetch_add_explicit(&site->allocs, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&site->alloc_bytes, _amount * _size, memory_order_relaxed);
+	return calloc(_amount, _size);
+}
+
+static inline void* inst_realloc(void* _ptr, const u64 _size)
+{
+	Inst_site_t* site = inst_current();
+	void* mem = realloc(_ptr, _size);
+	if (!_ptr) {
+		atomic_fetch_add_explicit(&site->allocs, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&site->alloc_bytes, _size, memory_order_relaxed);
+		return mem;
+	}
+
+	atomic_fetch_add_explicit(&site->reallocs, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&site->realloc_bytes, _size, memory_order_relaxed);
+	if (mem && mem != _ptr) atomic_fetch_add_explicit(&site->realloc_moves, 1, memory_order_relaxed);
+	return mem;
+}
+
+static inline void inst_free(void* _ptr)
+{
+	if (_ptr) atomic_fetch_add_explicit(&inst_current()->frees, 1, memory_order_relaxed);
+	free(_ptr);
+}
+
+static inline void inst_copied(const u64 _bytes)
+{
+	atomic_fetch_add_explicit(&inst_current()->copy_bytes, _bytes, memory_order_relaxed);
+}
+
+#define CT_INSTRUMENT_FN(_name) \
+	static Inst_site_t _ct_inst_site = { .name = (_name) }; \
+	Inst_scope_t _ct_inst_scope __attribute__((cleanup(inst_leave), unused)) = inst_enter(&_ct_inst_site)
+
+#define CT_MALLOC(_size) inst_malloc((_size))
+#define CT_CALLOC(_amount, _size) inst_calloc((_amount), (_size))
+#define CT_REALLOC(_ptr, _size) inst_realloc((_ptr), (_size))
+#define CT_FREE(_ptr) inst_free((_ptr))
+#define CT_COPIED(_bytes) inst_copied((_bytes))
+
+static Inst_stats_t inst_snapshot(const Inst_site_t* restrict _site)
+{
+	Inst_stats_t stats = {
+		.name = _site->name,
+		.calls = atomic_load_explicit(&_site->calls, memory_order_relaxed),
+		.allocs = atomic_load_explicit(&_site->allocs, memory_order_relaxed),
+		.alloc_bytes = atomic_load_explicit(&_site->alloc_bytes, memory_order_relaxed),
+		.reallocs = atomic_load_explicit(&_site->reallocs, memory_order_relaxed),
+		.realloc_bytes = atomic_load_explicit(&_site->realloc_bytes, memory_order_relaxed),
+		.realloc_moves = atomic_load_explicit(&_site->realloc_moves, memory_order_relaxed),
+		.frees = atomic_load_explicit(&_site->frees, memory_order_relaxed),
+		.copy_bytes = atomic_load_explicit(&_site->copy_bytes, memory_order_relaxed),
+		.ticks = atomic_load_explicit(&_site->ticks, memory_order_relaxed),
+		.ticks_max = atomic_load_explicit(&_site->ticks_max, memory_order_relaxed),
+	};
+	for ( u64 idx = 0; idx < INST_BUCKETS; ++idx )
+		stats.hist[idx] = atomic_load_explicit(&_site->hist[idx], memory_order_relaxed);
+	return stats;
+}
+
+CT_API const bool Inst_enabled(void)
+{
+	return true;
+}
+
+CT_API u64 Inst_collect(Inst_stats_t* restrict _out, const register u64 _max)
+/*
+ | Copies the counters of up to _max sites into _out, returns how many sites exist
+*/
+{
+	u64 count = 0;
+	for ( Inst_site_t* site = atomic_load_explicit(&INST_SITES, memory_order_acquire); site; site = site->next ) {
+		if (_out && count < _max) _out[count] = inst_snapshot(site);
+		++count;
+	}
+	return count;
+}
+
+CT_API Optional(Inst_stats_t) Inst_stats(const char* restrict _name)
+{
+	if (!_name) return None(Inst_stats_t);
+	for ( Inst_site_t* site = atomic_load_explicit(&INST_SITES, memory_order_acquire); site; site = site->next )
+		if (strcmp(site->name, _name) == 0) return Some(Inst_stats_t, inst_snapshot(site));
+	return None(Inst_stats_t);
+}
+
+CT_API void Inst_reset(void)
+{
+	for ( Inst_site_t* site = atomic_load_explicit(&INST_SITES, memory_order_acquire); site; site = site->next ) {
+		atomic_store_explicit(&site->calls, 0, memory_order_relaxed);
+		atomic_store_explicit(&site->allocs, 0, memory_order_relaxed);
+		atomic_store_explicit(&site->alloc_bytes, 0, memory_order_relaxed);
+		atomic_store_explicit(&site->reallocs, 0, memory_order_relaxed);
+		atomic_store_explicit(&site->realloc_bytes, 0, memory_order_relaxed);
+		atomic_store_explicit(&site->realloc_moves, 0, memory_order_relaxed);
+		atomic_store_explicit(&site->frees, 0, memory_order_relaxed);
+		atomic_store_explicit(&site->copy_bytes, 0, memory_order_relaxed);
+		atomic_store_explicit(&site->ticks, 0, memory_order_relaxed);
+		atomic_store_explicit(&site->ticks_max, 0, memory_order_relaxed);
+		for ( u64 idx = 0; idx < INST_BUCKETS; ++idx )
+			atomic_store_explicit(&site->hist[idx], 0, memory_order_relaxed);
+	}
+}
+
+#else
+
+#define INST_TICK_UNIT "ns"
+
+#define CT_INSTRUMENT_FN(_name)
+#define CT_MALLOC(_size) malloc((_size))
+#define CT_CALLOC(_amount, _size) calloc((_amount), (_size))
+#define CT_REALLOC(_ptr, _size) realloc((_ptr), (_size))
+#define CT_FREE(_ptr) free((_ptr))
+#define CT_COPIED(_bytes) ((void)sizeof(_bytes))
+
+CT_API const bool Inst_enabled(void)
+{
+	return false;
+}
+
+CT_API u64 Inst_collect(Inst_stats_t* restrict _out, const register u64 _max)
+{
+	(void)_out;
+	(void)_max;
+	return 0;
+}
+
+CT_API Optional(Inst_stats_t) Inst_stats(const char* restrict _name)
+{
+	(void)_name;
+	return None(Inst_stats_t);
+}
+
+CT_API void Inst_reset(void)
+{
+	return;
+}
+
+#endif // End CT_INSTRUMENT
+
+static const u64 inst_percentile(const Inst_stats_t* restrict _stats, const register u64 _pct)
+/*
+ | Upper bound of the histogram bucket holding the _pct-th percentile call
+*/
+{
+	u64 total = 0;
+	for ( u64 idx = 0; idx < INST_BUCKETS; ++idx ) total += _stats->hist[idx];
+	if (total == 0) return 0;
+
+	const u64 rank = (total * _pct + 99) / 100;
+	u64 seen = 0;
+	for ( u64 idx = 0; idx < INST_BUCKETS; ++idx ) {
+		seen += _stats->hist[idx];
+		if (seen >= rank) return (idx == 0) ? 0 : (1UL << idx) - 1;
+	}
+	return _stats->ticks_max;
+}
+
+static int inst_cmp_ticks(const void* _a, const void* _b)
+{
+	const u64 a = ((const Inst_stats_t*)_a)->ticks;
+	const u64 b = ((const Inst_stats_t*)_b)->ticks;
+	return (a < b) - (a > b);
+}
+
+CT_API void Inst_report(FILE* restrict _out)
+/*
+ | Prints one row per site that saw any work, hottest first by total time
+*/
+{
+	if (!_out) return;
+	if (!Inst_enabled()) {
+		fprintf(_out, "instrumentation disabled, rebuild with -DCT_INSTRUMENT\n");
+		return;
+	}
+
+	const u64 n_sites = Inst_collect(NULL, 0);
+	Inst_stats_t* stats = (Inst_stats_t*)malloc(n_sites * sizeof(Inst_stats_t) + 1);
+	if (!stats) return;
+	Inst_collect(stats, n_sites);
+	qsort(stats, n_sites, sizeof(Inst_stats_t), inst_cmp_ticks);
+
+	fprintf(_out, "%-24s %10s %8s %12s %8s %6s %8s %12s %12s %10s %10s %12s  (%s)\n",
+			"site", "calls", "allocs", "alloc B", "reallocs", "moved", "frees", "copy B",
+			"total", "p50", "p99", "max", INST_TICK_UNIT);
+	for ( u64 idx = 0; idx < n_sites; ++idx ) {
+		const Inst_stats_t* site = &stats[idx];
+		if (site->calls == 0 && site->allocs == 0 && site->reallocs == 0 && site->frees == 0 && site->copy_bytes == 0) continue;
+		fprintf(_out, "%-24s %10lu %8lu %12lu %8lu %6lu %8lu %12lu %12lu %10lu %10lu %12lu\n",
+				site->name, site->calls, site->allocs, site->alloc_bytes, site->reallocs, site->realloc_moves,
+				site->frees, site->copy_bytes, site->ticks, inst_percentile(site, 50), inst_percentile(site, 99),
+				site->ticks_max);
+	}
+
+	free(stats);
+}
+
+struct Inst_funcs {
+	const bool				(*enabled)(void);
+	u64						(*collect)(Inst_stats_t* restrict, const register u64);
+	Optional(Inst_stats_t)	(*stats)(const char* restrict);
+	void					(*reset)(void);
+	void					(*report)(FILE* restrict);
+};
+
+const static struct Inst_funcs Inst = {
+	Inst_enabled,
+	Inst_collect,
+	Inst_stats,
+	Inst_reset,
+	Inst_report,
+};
+
+#endif // End _CT_STL_INSTRUMENT_H
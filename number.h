@@ -0,0 +1,560 @@
+#ifndef _CT_STL_NUMBER_H
+#define _CT_STL_NUMBER_H
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "string.h"
+#include "stack_string.h"
+#include "pow10_table.h"
+#include "optional.h"
+#include "types.h"
+
+#define NUM_U64_MAX_LEN 20
+#define NUM_F64_MAX_LEN 32
+#define NUM_PARSE_BUF 128
+
+static const char NUM_DIGIT_PAIRS[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const d64 NUM_POW10_EXACT[23] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+struct Num_funcs {
+	// parsing, the whole span must be a number
+	Optional(i64)	(*to_i64)(const char* restrict, const u64);
+	Optional(u64)	(*to_u64)(const char* restrict, const u64);
+	Optional(d64)	(*to_f64)(const char* restrict, const u64);
+
+	// formatting
+	const bool		(*append_i64)(String_t*, const i64);
+	const bool		(*append_u64)(String_t*, const u64);
+	const bool		(*append_f64)(String_t*, const d64);
+	const bool		(*ss_append_i64)(SS_t* restrict, const i64);
+	const bool		(*ss_append_u64)(SS_t* restrict, const u64);
+	const bool		(*ss_append_f64)(SS_t* restrict, const d64);
+};
+
+static inline u64 num_load_u64(const char* restrict _str)
+{
+	u64 val;
+	memcpy(&val, _str, sizeof(u64));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	val = __builtin_bswap64(val);
+#endif
+	return val;
+}
+
+static inline const bool num_is_8_digits(const u64 _val)
+/*
+ | SWAR check that all 8 bytes are within '0'..'9'
+ | Source: https://lemire.me/blog/2022/01/21/swar-explained-parsing-eight-digits/
+*/
+{
+	return (((_val & 0xF0F0F0F0F0F0F0F0) | (((_val + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333);
+}
+
+static inline u32 num_parse_8_digits(u64 _val)
+/*
+ | Converts 8 ascii digits to their value with three multiplies instead of eight
+*/
+{
+	const u64 mask = 0x000000FF000000FF;
+	const u64 mul1 = 0x000F424000000064;
+	const u64 mul2 = 0x0000271000000001;
+
+	_val -= 0x3030303030303030;
+	_val = (_val * 10) + (_val >> 8);
+	return (u32)((((_val & mask) * mul1) + (((_val >> 16) & mask) * mul2)) >> 32);
+}
+
+static const bool num_parse_u64(const char* _str, const char* _end, u64* _val)
+/*
+ | Parses the digits in [_str, _end) into _val, fails on anything else or on overflow
+*/
+{
+	if (_str == _end) return false;
+
+	u64 val = 0;
+	while ( _end - _str >= 8 ) {
+		const u64 chunk = num_load_u64(_str);
+		if (!num_is_8_digits(chunk)) break;
+		if (__builtin_mul_overflow(val, 100000000UL, &val)) return false;
+		if (__builtin_add_overflow(val, num_parse_8_digits(chunk), &val)) return false;
+		_str += 8;
+	}
+
+	for ( ; _str < _end; ++_str ) {
+		const u8 digit = (u8)(*_str - '0');
+		if (digit > 9) return false;
+		if (__builtin_mul_overflow(val, 10UL, &val)) return false;
+		if (__builtin_add_overflow(val, digit, &val)) return false;
+	}
+
+	*_val = val;
+	return true;
+}
+
+static const bool num_eisel_lemire(u64 _mant, const i64 _exp10, const bool _neg, d64* _out)
+/*
+ | Converts _mant * 10^_exp10 to the nearest double using a 128 bit approximation of the power of ten
+ | Returns false for the rare inputs the approximation can not decide, the caller must fall back
+ | Source: https://arxiv.org/abs/2101.11408 (port of Go's strconv.eiselLemire64)
+*/
+{
+	if (_mant == 0 || _exp10 < POW10_MIN_EXP || _exp10 > POW10_MAX_EXP) return false;
+
+	const u64 clz = __builtin_clzll(_mant);
+	_mant <<= clz;
+	u64 ret_exp2 = (u64)(((217706 * _exp10) >> 16) + 64 + 1023) - clz;
+
+	const u64* pow = POW10_TABLE[_exp10 - POW10_MIN_EXP];
+	const unsigned __int128 x = (unsigned __int128)_mant * pow[1];
+	u64 x_hi = (u64)(x >> 64);
+	u64 x_lo = (u64)x;
+
+	// the low 9 bits are all ones so the truncated power may matter, widen to 192 bits
+	if ((x_hi & 0x1FF) == 0x1FF && x_lo + _mant < _mant) {
+		const unsigned __int128 y = (unsigned __int128)_mant * pow[0];
+		const u64 y_hi = (u64)(y >> 64);
+		const u64 y_lo = (u64)y;
+		u64 merged_hi = x_hi;
+		const u64 merged_lo = x_lo + y_hi;
+		if (merged_lo < x_lo) ++merged_hi;
+		if ((merged_hi & 0x1FF) == 0x1FF && merged_lo + 1 == 0 && y_lo + _mant < _mant) return false;
+		x_hi = merged_hi;
+		x_lo = merged_lo;
+	}
+
+	const u64 msb = x_hi >> 63;
+	u64 ret_mant = x_hi >> (msb + 9);
+	ret_exp2 -= 1 ^ msb;
+
+	// exactly half way between two doubles, let the slow path round to even
+	if (x_lo == 0 && (x_hi & 0x1FF) == 0 && (ret_mant & 3) == 1) return false;
+
+	ret_mant += ret_mant & 1;
+	ret_mant >>= 1;
+	if (ret_mant >> 53) {
+		ret_mant >>= 1;
+		++ret_exp2;
+	}
+
+	// subnormals and overflow go to the slow path
+	if (ret_exp2 - 1 >= 0x7FF - 1) return false;
+
+	u64 bits = (ret_exp2 << 52) | (ret_mant & 0x000FFFFFFFFFFFFF);
+	if (_neg) bits |= 0x8000000000000000;
+	memcpy(_out, &bits, sizeof(d64));
+
+	return true;
+}
+
+static d64 num_strtod(const char* restrict _str, const u64 _str_len)
+/*
+ | Slow path for the inputs Eisel-Lemire rejects, strtod needs a terminated copy
+*/
+{
+	char buf[NUM_PARSE_BUF];
+	char* copy = (_str_len < NUM_PARSE_BUF) ? buf : (char*)CT_MALLOC(_str_len + 1);
+	if (!copy) return NAN;
+
+	memcpy(copy, _str, _str_len);
+	copy[_str_len] = '\0';
+	const d64 val = strtod(copy, NULL);
+
+	if (copy != buf) CT_FREE(copy);
+	return val;
+}
+
+CT_API Optional(u64) Num_to_u64(const char* restrict _str, const u64 _str_len)
+/*
+ | Parses an unsigned decimal integer with an optional leading '+'
+*/
+{
+	if (!_str || _str_len == 0) return None(u64);
+
+	const char* curr = _str;
+	if (*curr == '+') ++curr;
+
+	u64 val;
+	if (!num_parse_u64(curr, _str + _str_len, &val)) return None(u64);
+
+	return Some(u64, val);
+}
+
+CT_API Optional(i64) Num_to_i64(const char* restrict _str, const u64 _str_len)
+/*
+ | Parses a signed decimal integer with an optional leading '+' or '-'
+*/
+{
+	if (!_str || _str_len == 0) return None(i64);
+
+	const char* curr = _str;
+	const bool neg = (*curr == '-');
+	if (*curr == '-' || *curr == '+') ++curr;
+
+	u64 val;
+	if (!num_parse_u64(curr, _str + _str_len, &val)) return None(i64);
+	if (val > (neg ? (1UL << 63) : (1UL << 63) - 1)) return None(i64);
+
+	return Some(i64, neg ? (i64)(0 - val) : (i64)val);
+}
+
+CT_API Optional(d64) Num_to_f64(const char* restrict _str, const u64 _str_len)
+/*
+ | Parses a decimal floating point number: [+-]digits[.digits][(e|E)[+-]digits], inf or nan
+ | The first 19 significant digits are gathered 8 at a time, then Clinger's exact fast path
+ | or Eisel-Lemire turns them into a double, strtod is only used when both give up
+*/
+{
+	if (!_str || _str_len == 0) return None(d64);
+
+	const char* curr = _str;
+	const char* end = _str + _str_len;
+	const bool neg = (*curr == '-');
+	if (*curr == '-' || *curr == '+') ++curr;
+
+	if (end - curr == 3 || end - curr == 8) {
+		if (strncasecmp(curr, "inf", end - curr) == 0 || strncasecmp(curr, "infinity", end - curr) == 0)
+			return Some(d64, neg ? -INFINITY : INFINITY);
+		if (strncasecmp(curr, "nan", end - curr) == 0)
+			return Some(d64, NAN);
+	}
+
+	u64 mant = 0;
+	i64 exp10 = 0;
+	u32 n_digits = 0;
+	bool any_digit = false;
+	bool truncated = false;
+
+	while ( curr < end && *curr == '0' ) {
+		any_digit = true;
+		++curr;
+	}
+	while ( n_digits + 8 <= 19 && end - curr >= 8 && num_is_8_digits(num_load_u64(curr)) ) {
+		mant = mant * 100000000 + num_parse_8_digits(num_load_u64(curr));
+		n_digits += 8;
+		any_digit = true;
+		curr += 8;
+	}
+	for ( u8 digit; curr < end && (digit = (u8)(*curr - '0')) <= 9; ++curr ) {
+		any_digit = true;
+		if (n_digits < 19) {
+			mant = mant * 10 + digit;
+			++n_digits;
+		} else {
+			++exp10;
+			truncated |= (digit != 0);
+		}
+	}
+
+	if (curr < end && *curr == '.') {
+		++curr;
+		if (n_digits == 0) {
+			while ( curr < end && *curr == '0' ) {
+				any_digit = true;
+				--exp10;
+				++curr;
+			}
+		}
+		while ( n_digits + 8 <= 19 && end - curr >= 8 && num_is_8_digits(num_load_u64(curr)) ) {
+			mant = mant * 100000000 + num_parse_8_digits(num_load_u64(curr));
+			n_digits += 8;
+			exp10 -= 8;
+			any_digit = true;
+			curr += 8;
+		}
+		for ( u8 digit; curr < end && (digit = (u8)(*curr - '0')) <= 9; ++curr ) {
+			any_digit = true;
+			if (n_digits < 19) {
+				mant = mant * 10 + digit;
+				++n_digits;
+				--exp10;
+			} else {
+				truncated |= (digit != 0);
+			}
+		}
+	}
+	if (!any_digit) return None(d64);
+
+	if (curr < end && (*curr == 'e' || *curr == 'E')) {
+		++curr;
+		const bool exp_neg = (curr < end && *curr == '-');
+		if (curr < end && (*curr == '-' || *curr == '+')) ++curr;
+		if (curr == end) return None(d64);
+
+		i64 exp = 0;
+		for ( u8 digit; curr < end && (digit = (u8)(*curr - '0')) <= 9; ++curr )
+			if (exp < 100000) exp = exp * 10 + digit;
+		exp10 += exp_neg ? -exp : exp;
+	}
+	if (curr != end) return None(d64);
+
+	if (mant == 0) return Some(d64, neg ? -0.0 : 0.0);
+
+	// Clinger: both operands are exact doubles so one rounding gives the right answer
+	if (!truncated && exp10 >= -22 && exp10 <= 22 && mant <= (1UL << 53)) {
+		const d64 val = (exp10 < 0) ? (d64)mant / NUM_POW10_EXACT[-exp10] : (d64)mant * NUM_POW10_EXACT[exp10];
+		return Some(d64, neg ? -val : val);
+	}
+
+	// with dropped digits the true value lies between mant and mant+1, agreeing bounds decide it
+	d64 val, upper;
+	if (num_eisel_lemire(mant, exp10, neg, &val)
+			&& (!truncated || (num_eisel_lemire(mant + 1, exp10, neg, &upper) && upper == val)))
+		return Some(d64, val);
+
+	return Some(d64, num_strtod(_str, _str_len));
+}
+
+static char* num_format_u64(char* _end, u64 _val)
+/*
+ | Writes _val backwards ending at _end two digits at a time, returns the first character
+*/
+{
+	char* curr = _end;
+	while ( _val >= 100 ) {
+		const u64 pair = _val % 100;
+		_val /= 100;
+		curr -= 2;
+		memcpy(curr, &NUM_DIGIT_PAIRS[pair * 2], 2);
+	}
+	if (_val >= 10) {
+		curr -= 2;
+		memcpy(curr, &NUM_DIGIT_PAIRS[_val * 2], 2);
+	} else {
+		*--curr = (char)('0' + _val);
+	}
+	return curr;
+}
+
+static char* num_format_i64(char* _end, const i64 _val)
+{
+	if (_val >= 0) return num_format_u64(_end, (u64)_val);
+	char* curr = num_format_u64(_end, 0 - (u64)_val);
+	*--curr = '-';
+	return curr;
+}
+
+static inline u64 num_round_to_odd(const u64* _pow, const u64 _cp)
+/*
+ | Upper 64 bits of the 192 bit product of the 128 bit { low, high } _pow and _cp, the lowest
+ | bit is set when any of the dropped bits were, which is all the rounding below needs to know
+*/
+{
+	const unsigned __int128 lo = (unsigned __int128)_pow[0] * _cp;
+	const unsigned __int128 hi = (unsigned __int128)_pow[1] * _cp + (u64)(lo >> 64);
+	return (u64)(hi >> 64) | ((u64)hi > 1);
+}
+
+static i64 num_shortest_f64(const u64 _bits, u64* _digits)
+/*
+ | Schubfach: finds the shortest _digits * 10^exp inside the interval of reals that round to the
+ | positive finite double _bits, the closest such decimal when there are several, returns exp
+ | Three multiplies against POW10_TABLE bound the interval, no bignum or fallback is needed
+ | Source: R. Giulietti, "The Schubfach way to render doubles", laid out after Drachennest's
+ | schubfach_64.cc (https://github.com/abolz/Drachennest)
+*/
+{
+	const u64 ieee_mant = _bits & 0x000FFFFFFFFFFFFF;
+	const i64 ieee_exp = (i64)(_bits >> 52);
+
+	const u64 mant = ieee_exp ? (ieee_mant | (1UL << 52)) : ieee_mant;
+	const i64 exp2 = (ieee_exp ? ieee_exp : 1) - 1075;
+
+	// the gap to the next lower double halves at a power of two
+	const bool lower_closer = (ieee_mant == 0 && ieee_exp > 1);
+	const bool even = !(mant & 1);
+
+	// floor(log10(2^exp2)), or floor(log10(3/4 * 2^exp2)) when the lower bound is closer
+	const i64 exp10 = (exp2 * 1262611 - (lower_closer ? 524031 : 0)) >> 22;
+	// 10^-exp10 scaled so the bounds keep 1 to 4 bits past the point
+	const i64 shift = exp2 + ((-exp10 * 1741647) >> 19) + 1;
+
+	// the table rounds down, Schubfach wants it rounded up unless the power of ten is exact
+	const u64* floor_pow = POW10_TABLE[-exp10 - POW10_MIN_EXP];
+	u64 pow[2] = { floor_pow[0], floor_pow[1] };
+	if (-exp10 < 0 || -exp10 > 55) {
+		pow[0] += 1;
+		pow[1] += (pow[0] == 0);
+	}
+
+	const u64 lower_bound = num_round_to_odd(pow, (4 * mant - 2 + lower_closer) << shift) + !even;
+	const u64 middle = num_round_to_odd(pow, (4 * mant) << shift);
+	const u64 upper_bound = num_round_to_odd(pow, (4 * mant + 2) << shift) - !even;
+
+	// one digit shorter first, at most one of its two neighbours can be inside the interval
+	const u64 digits = middle / 4;
+	if (digits >= 10) {
+		const u64 shorter = digits / 10;
+		const bool down_inside = lower_bound <= 40 * shorter;
+		const bool up_inside = 40 * shorter + 40 <= upper_bound;
+		if (down_inside != up_inside) {
+			*_digits = shorter + up_inside;
+			return exp10 + 1;
+		}
+	}
+
+	const bool down_inside = lower_bound <= 4 * digits;
+	const bool up_inside = 4 * digits + 4 <= upper_bound;
+	if (down_inside != up_inside) {
+		*_digits = digits + up_inside;
+		return exp10;
+	}
+
+	// both neighbours are inside, take the closer one and break ties to even
+	const u64 half = 4 * digits + 2;
+	*_digits = digits + (middle > half || (middle == half && (digits & 1)));
+	return exp10;
+}
+
+static u64 num_format_f64(char* _buf, const d64 _val)
+/*
+ | Writes the shortest decimal that parses back to exactly _val, returns its length
+ | Integral values below 1e15 are written as integers, everything else goes through Schubfach
+ | and is laid out like printf's %g: plain notation for exponents -5 to 14, otherwise d.ddde[+-]XX
+*/
+{
+	if (isnan(_val)) {
+		memcpy(_buf, "nan", 3);
+		return 3;
+	}
+	if (isinf(_val)) {
+		memcpy(_buf, (_val < 0) ? "-inf" : "inf", (_val < 0) ? 4 : 3);
+		return (_val < 0) ? 4 : 3;
+	}
+	if (_val == 0 && signbit(_val)) {
+		memcpy(_buf, "-0", 2);
+		return 2;
+	}
+	if (_val > -1e15 && _val < 1e15 && (d64)(i64)_val == _val) {
+		char* end = _buf + NUM_F64_MAX_LEN;
+		char* start = num_format_i64(end, (i64)_val);
+		memmove(_buf, start, end - start);
+		return end - start;
+	}
+
+	u64 bits;
+	memcpy(&bits, &_val, sizeof(d64));
+
+	u64 digits;
+	i64 exp10 = num_shortest_f64(bits & 0x7FFFFFFFFFFFFFFF, &digits);
+	while ( digits % 10 == 0 ) {
+		digits /= 10;
+		++exp10;
+	}
+
+	char digit_buf[NUM_U64_MAX_LEN];
+	const char* first = num_format_u64(digit_buf + NUM_U64_MAX_LEN, digits);
+	const i64 n_digits = (digit_buf + NUM_U64_MAX_LEN) - first;
+	// exponent of the leading digit, as printf's %e would show it
+	const i64 sci_exp = exp10 + n_digits - 1;
+
+	char* curr = _buf;
+	if (bits >> 63) *curr++ = '-';
+
+	if (sci_exp < -4 || sci_exp >= 15) {
+		*curr++ = first[0];
+		if (n_digits > 1) {
+			*curr++ = '.';
+			memcpy(curr, first + 1, n_digits - 1);
+			curr += n_digits - 1;
+		}
+		*curr++ = 'e';
+		*curr++ = (sci_exp < 0) ? '-' : '+';
+		const u64 abs_exp = (sci_exp < 0) ? (u64)-sci_exp : (u64)sci_exp;
+		if (abs_exp >= 100) {
+			*curr++ = (char)('0' + abs_exp / 100);
+		}
+		memcpy(curr, &NUM_DIGIT_PAIRS[(abs_exp % 100) * 2], 2);
+		curr += 2;
+	} else if (sci_exp < 0) {
+		memcpy(curr, "0.0000", 1 - sci_exp);
+		curr += 1 - sci_exp;
+		memcpy(curr, first, n_digits);
+		curr += n_digits;
+	} else if (n_digits <= sci_exp + 1) {
+		memcpy(curr, first, n_digits);
+		curr += n_digits;
+		memset(curr, '0', sci_exp + 1 - n_digits);
+		curr += sci_exp + 1 - n_digits;
+	} else {
+		memcpy(curr, first, sci_exp + 1);
+		curr += sci_exp + 1;
+		*curr++ = '.';
+		memcpy(curr, first + sci_exp + 1, n_digits - sci_exp - 1);
+		curr += n_digits - sci_exp - 1;
+	}
+	return curr - _buf;
+}
+
+CT_API const bool Num_append_u64(String_t* _string, const u64 _val)
+{
+	char buf[NUM_U64_MAX_LEN];
+	const char* start = num_format_u64(buf + NUM_U64_MAX_LEN, _val);
+	return String_append_n(_string, start, (buf + NUM_U64_MAX_LEN) - start);
+}
+
+CT_API const bool Num_append_i64(String_t* _string, const i64 _val)
+{
+	char buf[NUM_U64_MAX_LEN + 1];
+	const char* start = num_format_i64(buf + sizeof(buf), _val);
+	return String_append_n(_string, start, (buf + sizeof(buf)) - start);
+}
+
+CT_API const bool Num_append_f64(String_t* _string, const d64 _val)
+{
+	char buf[NUM_F64_MAX_LEN];
+	return String_append_n(_string, buf, num_format_f64(buf, _val));
+}
+
+CT_API const bool Num_ss_append_u64(SS_t* restrict _string, const u64 _val)
+{
+	char buf[NUM_U64_MAX_LEN];
+	const char* start = num_format_u64(buf + NUM_U64_MAX_LEN, _val);
+	return StackString_append_n(_string, start, (buf + NUM_U64_MAX_LEN) - start);
+}
+
+CT_API const bool Num_ss_append_i64(SS_t* restrict _string, const i64 _val)
+{
+	char buf[NUM_U64_MAX_LEN + 1];
+	const char* start = num_format_i64(buf + sizeof(buf), _val);
+	return StackString_append_n(_string, start, (buf + sizeof(buf)) - start);
+}
+
+CT_API const bool Num_ss_append_f64(SS_t* restrict _string, const d64 _val)
+{
+	char buf[NUM_F64_MAX_LEN];
+	return StackString_append_n(_string, buf, num_format_f64(buf, _val));
+}
+
+const static struct Num_funcs Num = {
+	Num_to_i64,
+	Num_to_u64,
+	Num_to_f64,
+	Num_append_i64,
+	Num_append_u64,
+	Num_append_f64,
+	Num_ss_append_i64,
+	Num_ss_append_u64,
+	Num_ss_append_f64,
+};
+
+#endif // End _CT_STL_NUMBER_H
@@ -19,7 +19,7 @@
 // End None
 
 #define Optional_t(_optional_t) \
-	typedef union { \
+	typedef struct { \
 			bool is_none; \
 			_optional_t contents; \
 	} Optional(_optional_t)
@@ -0,0 +1,593 @@
+#ifndef _CT_STL_PAR_STRING_H
+#define _CT_STL_PAR_STRING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "string.h"
+#include "thread_pool.h"
+#include "optional.h"
+#include "alloc.h"
+#include "types.h"
+
+/*
+ | Buffers shorter than the threshold take the serial path, the chunk size is picked
+ | so that one chunk stays resident in a typical L2 while a worker scans it
+*/
+#ifndef PAR_STRING_THRESHOLD
+#define PAR_STRING_THRESHOLD (1UL << 22)
+#endif
+
+#ifndef PAR_STRING_CHUNK
+#define PAR_STRING_CHUNK (1UL << 18)
+#endif
+
+static u64 ParString_threshold = PAR_STRING_THRESHOLD;
+static Pool_t* ParString_pool = NULL;
+
+struct ParString_funcs {
+	// search / algo methods
+	Optional(u64)	(*find)(const String_t*, const char*);
+	u64				(*count)(const String_t*, const char*);
+
+	// string manipulation functions
+	const bool		(*remove)(String_t*, const char*);
+	const bool		(*replace_char)(String_t*, const char, const char);
+	const bool		(*toupper)(String_t*);
+	const bool		(*tolower)(String_t*);
+
+	// tuning
+	void			(*set_threshold)(const register u64);
+	void			(*set_pool)(Pool_t*);
+};
+
+// entry chains kept per chunk, a needle with more overlapping matches in one window than this
+// is periodic enough that the carries past the last chain just get rescanned
+#define PAR_STRING_CHAINS 8
+
+typedef struct ParString_chain {
+	u64 first;
+	u64 count;
+	u64 tail;
+} ParString_chain;
+
+typedef struct ParString_span {
+	u64 count;
+	u64 skip;
+	u64 tail;
+
+	// one chain per distinct first match a carry into the chunk can land on, in order of first,
+	// carries up to and including covered pick one of them, later ones are rescanned
+	u64 covered;
+	u64 n_chains;
+	ParString_chain chains[PAR_STRING_CHAINS];
+} ParString_span;
+
+typedef struct ParString_ctx {
+	char* data;
+	u64 len;
+	const char* needle;
+	u64 needle_len;
+	char from;
+	char to;
+	atomic_ulong found;
+	ParString_span* spans;
+	u64* offsets;
+	char* out;
+} ParString_ctx;
+
+static Pool_t* ParString_get_pool(const u64 _len)
+/*
+ | Returns the pool to run on, or NULL when _len should take the serial path
+*/
+{
+	if (_len < ParString_threshold) return NULL;
+	Pool_t* pool = ParString_pool ? ParString_pool : Pool_global();
+	return (Pool_threads(pool) > 1) ? pool : NULL;
+}
+
+static u64 ParString_count_span(const ParString_ctx* restrict _ctx, const u64 _from, const u64 _end, u64* _tail)
+/*
+ | Greedily counts the non overlapping matches that start in [_from, _end)
+ | The last match may run up to needle_len-1 bytes past _end, its end is stored in _tail
+*/
+{
+	const u64 stop = (_end + _ctx->needle_len - 1 < _ctx->len) ? _end + _ctx->needle_len - 1 : _ctx->len;
+	const char* curr = _ctx->data + _from;
+	const char* match;
+	u64 count = 0;
+
+	while ( curr < _ctx->data + _end
+			&& (match = string_memfind(curr, (_ctx->data + stop) - curr, _ctx->needle, _ctx->needle_len)) ) {
+		curr = match + _ctx->needle_len;
+		*_tail = curr - _ctx->data;
+		++count;
+	}
+
+	return count;
+}
+
+static u64 ParString_next_match(const ParString_ctx* restrict _ctx, const u64 _from, const u64 _end)
+/*
+ | Returns the index of the first match that starts in [_from, _end), or _end when there is none
+*/
+{
+	if (_from >= _end) return _end;
+	const u64 stop = (_end + _ctx->needle_len - 1 < _ctx->len) ? _end + _ctx->needle_len - 1 : _ctx->len;
+	const char* match = string_memfind(_ctx->data + _from, stop - _from, _ctx->needle, _ctx->needle_len);
+	return match ? (u64)(match - _ctx->data) : _end;
+}
+
+static u64 ParString_copy_span(const ParString_ctx* restrict _ctx, const u64 _from, const u64 _end, char* _out)
+/*
+ | Copies everything in [_from, _end) that is not part of a match to _out
+ | _out may alias the source as long as it never runs ahead of it
+*/
+{
+	const u64 stop = (_end + _ctx->needle_len - 1 < _ctx->len) ? _end + _ctx->needle_len - 1 : _ctx->len;
+	const char* curr = _ctx->data + _from;
+	const char* match;
+	char* out = _out;
+
+	while ( curr < _ctx->data + _end
+			&& (match = string_memfind(curr, (_ctx->data + stop) - curr, _ctx->needle, _ctx->needle_len)) ) {
+		memmove(out, curr, match - curr);
+		out += match - curr;
+		curr = match + _ctx->needle_len;
+	}
+	if (curr < _ctx->data + _end) {
+		memmove(out, curr, (_ctx->data + _end) - curr);
+		out += (_ctx->data + _end) - curr;
+	}
+
+	return out - _out;
+}
+
+static void ParString_find_chunk(void* _ctx, const u64 _begin, const u64 _end)
+{
+	ParString_ctx* ctx = (ParString_ctx*)_ctx;
+	if (_begin >= atomic_load_explicit(&ctx->found, memory_order_relaxed)) return;
+
+	const u64 stop = (_end + ctx->needle_len - 1 < ctx->len) ? _end + ctx->needle_len - 1 : ctx->len;
+	const char* match = string_memfind(ctx->data + _begin, stop - _begin, ctx->needle, ctx->needle_len);
+	if (!match) return;
+
+	const u64 idx = match - ctx->data;
+	u64 curr = atomic_load_explicit(&ctx->found, memory_order_relaxed);
+	while ( idx < curr && !atomic_compare_exchange_weak(&ctx->found, &curr, idx) )
+		continue;
+}
+
+static u64 ParString_shift_run(const ParString_ctx* restrict _ctx, const u64 _from, const u64 _shift, const u64 _stop)
+/*
+ | Returns the first index in [_from, _stop) whose byte differs from the one _shift bytes on, or _stop
+*/
+{
+	const char* data = _ctx->data;
+	u64 idx = _from;
+	// whole blocks through memcmp, the byte loop only narrows down the block that differs
+	while ( idx + 64 <= _stop && memcmp(data + idx, data + idx + _shift, 64) == 0 ) idx += 64;
+	while ( idx < _stop && data[idx] == data[idx + _shift] ) ++idx;
+	return idx;
+}
+
+static void ParString_count_chunk(void* _ctx, const u64 _begin, const u64 _end)
+/*
+ | A match from the chunk before can run up to needle_len-1 bytes into this one, and where it
+ | ends decides which of the chunk's matches the greedy scan takes, so the chunk is counted once
+ | per distinct first match such a carry can land on
+ | Chains are folded into the chain furthest behind as soon as they repeat it: right away once
+ | both resume at the same byte, or at an offset d when the rest of the chunk equals itself d
+ | bytes on, then every match the leader takes below the chunk's end minus d is one for them too
+ | So away from periodic text the chains fold within a match or two, inside a periodic run after
+ | one memcmp, and the rest of the chunk is a single plain count either way
+*/
+{
+	ParString_ctx* ctx = (ParString_ctx*)_ctx;
+	ParString_span* span = &ctx->spans[_begin / PAR_STRING_CHUNK];
+	ParString_chain* chains = span->chains;
+	const u64 needle_len = ctx->needle_len;
+	const u64 window = _begin + needle_len - 1;
+	const u64 stop = (_end + needle_len - 1 < ctx->len) ? _end + needle_len - 1 : ctx->len;
+	// every match of the chunk starts below limit, so it also fits before stop
+	const u64 limit = (stop + 1 > needle_len) ? stop + 1 - needle_len : 0;
+
+	// every chain starts on the first match past the previous chain's first
+	u64 n = 0;
+	u64 from = _begin;
+	for ( ; from <= window && n < PAR_STRING_CHAINS; ++n ) {
+		const u64 first = ParString_next_match(ctx, from, _end);
+		chains[n] = (ParString_chain){ .first = first, .count = (first < _end), .tail = (first < _end) ? first + needle_len : 0 };
+		from = (first < _end) ? first + 1 : window + 1;
+	}
+	span->n_chains = n;
+	span->covered = from - 1;
+
+	// a folded chain follows into[] at shift[] and takes its matches below until[]
+	u64 next[PAR_STRING_CHAINS];
+	u64 into[PAR_STRING_CHAINS];
+	u64 shift[PAR_STRING_CHAINS];
+	u64 until[PAR_STRING_CHAINS];
+	u64 recheck[PAR_STRING_CHAINS];
+	for ( u64 idx = 0; idx < n; ++idx ) {
+		next[idx] = chains[idx].count ? chains[idx].tail : _end;
+		into[idx] = idx;
+		shift[idx] = 0;
+		until[idx] = limit;
+		recheck[idx] = 0;
+	}
+
+	u64 lead;
+	for ( ;; ) {
+		u64 active = 0;
+		lead = n;
+		for ( u64 idx = 0; idx < n; ++idx ) {
+			if (into[idx] != idx || next[idx] >= _end) continue;
+			if (lead == n || next[idx] < next[lead]) lead = idx;
+			++active;
+		}
+
+		for ( u64 idx = 0; idx < n && active > 1; ++idx ) {
+			if (idx == lead || into[idx] != idx || next[idx] >= _end) continue;
+			const u64 d = next[idx] - next[lead];
+			if (d) {
+				// an offset that failed is only tried again once the leader is past the mismatch
+				if (next[lead] < recheck[idx]) continue;
+				const u64 run = ParString_shift_run(ctx, next[lead], d, stop - d);
+				if (run < stop - d) {
+					recheck[idx] = run + 1;
+					continue;
+				}
+			}
+			for ( u64 follower = 0; follower < n; ++follower ) {
+				if (into[follower] != idx) continue;
+				into[follower] = lead;
+				shift[follower] += d;
+				until[follower] = (limit > shift[follower]) ? limit - shift[follower] : 0;
+			}
+			--active;
+		}
+		if (active <= 1) break;
+
+		const u64 match = ParString_next_match(ctx, next[lead], _end);
+		if (match >= _end) {
+			lead = n;
+			break;
+		}
+
+		// every live chain resuming at or before the match takes it, and so do their followers
+		bool took[PAR_STRING_CHAINS] = { 0 };
+		for ( u64 idx = 0; idx < n; ++idx ) {
+			if (into[idx] != idx || next[idx] > match) continue;
+			took[idx] = true;
+			next[idx] = match + needle_len;
+		}
+		for ( u64 idx = 0; idx < n; ++idx ) {
+			if (!took[into[idx]] || match >= until[idx]) continue;
+			++chains[idx].count;
+			chains[idx].tail = match + needle_len + shift[idx];
+		}
+	}
+
+	// the last live chain scans the rest alone, in segments that end where a follower stops taking matches
+	if (lead < n && next[lead] < _end) {
+		bool settled[PAR_STRING_CHAINS] = { 0 };
+		u64 curr = next[lead];
+		u64 gained = 0;
+		u64 tail = 0;
+		for ( ;; ) {
+			u64 upto = _end;
+			u64 pick = n;
+			for ( u64 idx = 0; idx < n; ++idx )
+				if (into[idx] == lead && !settled[idx] && until[idx] < upto) {
+					upto = until[idx];
+					pick = idx;
+				}
+
+			if (curr < upto) {
+				u64 seg_tail = 0;
+				const u64 count = ParString_count_span(ctx, curr, upto, &seg_tail);
+				if (count) {
+					gained += count;
+					tail = seg_tail;
+				}
+				curr = (count && seg_tail > upto) ? seg_tail : upto;
+			}
+
+			// with nothing left to split on, everyone still open takes the whole count
+			for ( u64 idx = 0; idx < n; ++idx ) {
+				if (into[idx] != lead || settled[idx] || (pick < n && idx != pick)) continue;
+				settled[idx] = true;
+				if (!gained) continue;
+				chains[idx].count += gained;
+				chains[idx].tail = tail + shift[idx];
+			}
+			if (pick == n) break;
+		}
+	}
+
+	span->skip = 0;
+	span->count = chains[0].count;
+	span->tail = chains[0].tail;
+}
+
+static void ParString_copy_chunk(void* _ctx, const u64 _begin, const u64 _end)
+{
+	ParString_ctx* ctx = (ParString_ctx*)_ctx;
+	const u64 chunk = _begin / PAR_STRING_CHUNK;
+	const ParString_span* span = &ctx->spans[chunk];
+	if (_begin + span->skip >= _end) return;
+
+	ParString_copy_span(ctx, _begin + span->skip, _end, ctx->out + ctx->offsets[chunk]);
+}
+
+static void ParString_toupper_chunk(void* _ctx, const u64 _begin, const u64 _end)
+{
+	char* data = ((ParString_ctx*)_ctx)->data;
+	for ( u64 idx = _begin; idx < _end; ++idx )
+		data[idx] = ((u8)(data[idx] - 'a') < 26) ? data[idx] - 32 : data[idx];
+}
+
+static void ParString_tolower_chunk(void* _ctx, const u64 _begin, const u64 _end)
+{
+	char* data = ((ParString_ctx*)_ctx)->data;
+	for ( u64 idx = _begin; idx < _end; ++idx )
+		data[idx] = ((u8)(data[idx] - 'A') < 26) ? data[idx] + 32 : data[idx];
+}
+
+static void ParString_replace_chunk(void* _ctx, const u64 _begin, const u64 _end)
+{
+	// locals, a char store may alias the ctx fields and would force a reload per byte
+	char* data = ((ParString_ctx*)_ctx)->data;
+	const char from = ((ParString_ctx*)_ctx)->from;
+	const char to = ((ParString_ctx*)_ctx)->to;
+	for ( u64 idx = _begin; idx < _end; ++idx )
+		data[idx] = (data[idx] == from) ? to : data[idx];
+}
+
+static u64 ParString_resolve_spans(ParString_ctx* restrict _ctx, const u64 _n_chunks)
+/*
+ | Walks the chunks in order and picks for each the chain that the match carried over from the
+ | chunk before leads into, only a carry past the chains a chunk kept is rescanned
+ | Returns the total number of matches
+*/
+{
+	u64 carry = 0;
+	u64 total = 0;
+
+	for ( u64 idx = 0; idx < _n_chunks; ++idx ) {
+		ParString_span* span = &_ctx->spans[idx];
+		const u64 begin = idx * PAR_STRING_CHUNK;
+		const u64 end = (begin + PAR_STRING_CHUNK < _ctx->len) ? begin + PAR_STRING_CHUNK : _ctx->len;
+		const u64 skip = (carry > begin) ? carry - begin : 0;
+
+		span->skip = skip;
+		if (carry > span->covered) {
+			span->tail = 0;
+			span->count = (begin + skip < end) ? ParString_count_span(_ctx, begin + skip, end, &span->tail) : 0;
+		} else if (skip) {
+			// the first chain whose first match the carry has not run over, none means no match is left
+			u64 chain = 0;
+			while ( chain < span->n_chains && span->chains[chain].first < carry ) ++chain;
+			span->count = (chain < span->n_chains) ? span->chains[chain].count : 0;
+			span->tail = (chain < span->n_chains) ? span->chains[chain].tail : 0;
+		}
+
+		if (span->tail > carry) carry = span->tail;
+		total += span->count;
+	}
+
+	return total;
+}
+
+CT_API Optional(u64) ParString_find(const String_t* _string, const char* _str)
+/*
+ | Returns the index of the first occurance of _str, chunks are searched in parallel
+ | and each one also scans needle_len-1 bytes into the next to catch straddling matches
+*/
+{
+	if (!_string || !_str) return None(u64);
+
+	ParString_ctx ctx = {
+		.data = _string->data,
+		.len = _string->len,
+		.needle = _str,
+		.needle_len = strlen(_str),
+	};
+	atomic_init(&ctx.found, ctx.len);
+
+	Pool_t* pool = ParString_get_pool(ctx.len);
+	if (!pool || ctx.needle_len == 0) {
+		const char* match = string_memfind(ctx.data, ctx.len, ctx.needle, ctx.needle_len);
+		return match ? Some(u64, (u64)(match - ctx.data)) : None(u64);
+	}
+
+	Pool_parallel_for(pool, 0, ctx.len, PAR_STRING_CHUNK, ParString_find_chunk, &ctx);
+
+	const u64 found = atomic_load(&ctx.found);
+	return (found < ctx.len) ? Some(u64, found) : None(u64);
+}
+
+CT_API u64 ParString_count(const String_t* _string, const char* _str)
+/*
+ | Returns the number of non overlapping occurances of _str
+*/
+{
+	if (!_string || !_str || !*_str) return 0;
+
+	ParString_ctx ctx = {
+		.data = _string->data,
+		.len = _string->len,
+		.needle = _str,
+		.needle_len = strlen(_str),
+	};
+
+	Pool_t* pool = ParString_get_pool(ctx.len);
+	if (!pool) {
+		u64 tail = 0;
+		return ParString_count_span(&ctx, 0, ctx.len, &tail);
+	}
+
+	const u64 n_chunks = (ctx.len + PAR_STRING_CHUNK - 1) / PAR_STRING_CHUNK;
+	ctx.spans = (ParString_span*)CT_MALLOC(n_chunks * sizeof(ParString_span));
+	if (!ctx.spans) {
+		u64 tail = 0;
+		return ParString_count_span(&ctx, 0, ctx.len, &tail);
+	}
+
+	Pool_parallel_for(pool, 0, ctx.len, PAR_STRING_CHUNK, ParString_count_chunk, &ctx);
+	const u64 total = ParString_resolve_spans(&ctx, n_chunks);
+
+	CT_FREE(ctx.spans);
+	return total;
+}
+
+CT_API const bool ParString_remove(String_t* _string, const char* _str)
+/*
+ | Removes all instances of a substr
+ | Matches are counted per chunk in parallel, then every chunk copies its kept bytes to
+ | its precomputed offset in a freshly allocated buffer
+*/
+{
+	if (!_string || !_str || !*_str) return false;
+
+	ParString_ctx ctx = {
+		.data = _string->data,
+		.len = _string->len,
+		.needle = _str,
+		.needle_len = strlen(_str),
+	};
+
+	Pool_t* pool = ParString_get_pool(ctx.len);
+	const u64 n_chunks = (ctx.len + PAR_STRING_CHUNK - 1) / PAR_STRING_CHUNK;
+	if (pool) {
+		ctx.spans = (ParString_span*)CT_MALLOC(n_chunks * sizeof(ParString_span));
+		ctx.offsets = (u64*)CT_MALLOC(n_chunks * sizeof(u64));
+	}
+
+	if (!pool || !ctx.spans || !ctx.offsets) {
+		CT_FREE(ctx.spans);
+		CT_FREE(ctx.offsets);
+		u64 tail = 0;
+		if (!ParString_count_span(&ctx, 0, ctx.len, &tail)) return false;
+		if (!String_make_unique(_string)) return false;
+		ctx.data = _string->data;
+		_string->len = ParString_copy_span(&ctx, 0, ctx.len, ctx.data);
+		if (_string->len < _string->size) _string->data[_string->len] = '\0';
+		return true;
+	}
+
+	Pool_parallel_for(pool, 0, ctx.len, PAR_STRING_CHUNK, ParString_count_chunk, &ctx);
+	if (ParString_resolve_spans(&ctx, n_chunks) == 0) {
+		CT_FREE(ctx.spans);
+		CT_FREE(ctx.offsets);
+		return false;
+	}
+
+	u64 new_len = 0;
+	for ( u64 idx = 0; idx < n_chunks; ++idx ) {
+		const u64 begin = idx * PAR_STRING_CHUNK;
+		const u64 end = (begin + PAR_STRING_CHUNK < ctx.len) ? begin + PAR_STRING_CHUNK : ctx.len;
+		const ParString_span* span = &ctx.spans[idx];
+		const u64 overflow = (span->tail > end) ? span->tail - end : 0;
+
+		ctx.offsets[idx] = new_len;
+		if (begin + span->skip < end)
+			new_len += (end - begin - span->skip) - (span->count * ctx.needle_len) + overflow;
+	}
+
+	const u64 new_size = mem_round(new_len, MEM_ALIGNMENT);
+	// the kept bytes land in a fresh buffer, so a shared source is left untouched
+	ctx.out = string_buf_alloc(new_size);
+	if (ctx.out) {
+		Pool_parallel_for(pool, 0, ctx.len, PAR_STRING_CHUNK, ParString_copy_chunk, &ctx);
+		ctx.out[new_len] = '\0';
+
+		string_buf_release(_string->data);
+		_string->data = ctx.out;
+		_string->size = new_size;
+		_string->len = new_len;
+	}
+
+	CT_FREE(ctx.spans);
+	CT_FREE(ctx.offsets);
+	return ctx.out != NULL;
+}
+
+CT_API const bool ParString_replace_char(String_t* _string, const char _from, const char _to)
+/*
+ | Replaces every _from byte with _to
+*/
+{
+	if (!_string) return false;
+	if (!String_make_unique(_string)) return false;
+
+	ParString_ctx ctx = {
+		.data = _string->data,
+		.len = _string->len,
+		.from = _from,
+		.to = _to,
+	};
+	Pool_parallel_for(ParString_get_pool(ctx.len), 0, ctx.len, PAR_STRING_CHUNK, ParString_replace_chunk, &ctx);
+
+	return true;
+}
+
+CT_API const bool ParString_toupper(String_t* _string)
+/*
+ | Converts the given string to all uppercase characters
+*/
+{
+	if (!_string) return false;
+	if (!String_make_unique(_string)) return false;
+
+	ParString_ctx ctx = { .data = _string->data, .len = _string->len };
+	Pool_parallel_for(ParString_get_pool(ctx.len), 0, ctx.len, PAR_STRING_CHUNK, ParString_toupper_chunk, &ctx);
+
+	return true;
+}
+
+CT_API const bool ParString_tolower(String_t* _string)
+/*
+ | Converts the given string to all lowercase characters
+*/
+{
+	if (!_string) return false;
+	if (!String_make_unique(_string)) return false;
+
+	ParString_ctx ctx = { .data = _string->data, .len = _string->len };
+	Pool_parallel_for(ParString_get_pool(ctx.len), 0, ctx.len, PAR_STRING_CHUNK, ParString_tolower_chunk, &ctx);
+
+	return true;
+}
+
+CT_API void ParString_set_threshold(const register u64 _threshold)
+/*
+ | Buffers shorter than _threshold bytes are processed on the calling thread
+*/
+{
+	ParString_threshold = _threshold;
+}
+
+CT_API void ParString_set_pool(Pool_t* _pool)
+/*
+ | Runs the parallel paths on _pool instead of the global pool, NULL restores the default
+*/
+{
+	ParString_pool = _pool;
+}
+
+const static struct ParString_funcs ParString = {
+	ParString_find,
+	ParString_count,
+	ParString_remove,
+	ParString_replace_char,
+	ParString_toupper,
+	ParString_tolower,
+	ParString_set_threshold,
+	ParString_set_pool,
+};
+
+#endif // End _CT_STL_PAR_STRING_H
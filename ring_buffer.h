@@ -0,0 +1,234 @@
+#ifndef _CT_STL_RING_BUFFER_H
+#define _CT_STL_RING_BUFFER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "string.h"
+#include "stack_string.h"
+#include "alloc.h"
+#include "types.h"
+
+/*
+ | Bounded lock free ring buffers, the capacity is rounded up to a power of two
+ |
+ | SPSC: one producer thread, one consumer thread, each index lives on its own cache line
+ |       next to a cached copy of the other side's index so the fast path never touches
+ |       the other core's line
+ | MPMC: any number of producers and consumers, Dmitry Vyukov's bounded queue where each
+ |       cell carries a sequence number
+ |       Source: https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ |
+ | Values are copied into the ring, so SS_t travels inline while String_t is passed as a
+ | String_ptr whose ownership moves to whoever pops it
+*/
+
+#define SPSC(_ring_t) spsc_##_ring_t##_t
+#define MPMC(_ring_t) mpmc_##_ring_t##_t
+#define SPSC_fn(_ring_t, _fn) spsc_##_ring_t##_##_fn
+#define MPMC_fn(_ring_t, _fn) mpmc_##_ring_t##_##_fn
+
+static inline u64 ring_capacity(const u64 _capacity)
+{
+	u64 capacity = 2;
+	while ( capacity < _capacity ) capacity <<= 1;
+	return capacity;
+}
+
+#define Ring_SPSC_t(_ring_t) \
+	typedef struct SPSC(_ring_t) { \
+		_Alignas(CACHE_LINE) atomic_ulong head; \
+		u64 tail_cache; \
+		_Alignas(CACHE_LINE) atomic_ulong tail; \
+		u64 head_cache; \
+		_Alignas(CACHE_LINE) u64 mask; \
+		_ring_t* buf; \
+	} SPSC(_ring_t); \
+	\
+	static inline SPSC(_ring_t)* SPSC_fn(_ring_t, create)(const u64 _capacity) \
+	{ \
+		/* the header needs cache line alignment, which CT_MALLOC can not give, so it stays on aligned_alloc */ \
+		SPSC(_ring_t)* ring = (SPSC(_ring_t)*)aligned_alloc(CACHE_LINE, sizeof(SPSC(_ring_t))); \
+		if (!ring) return NULL; \
+		ring->mask = ring_capacity(_capacity) - 1; \
+		ring->buf = (_ring_t*)CT_MALLOC((ring->mask + 1) * sizeof(_ring_t)); \
+		if (!ring->buf) { free(ring); return NULL; } \
+		atomic_init(&ring->head, 0); \
+		atomic_init(&ring->tail, 0); \
+		ring->tail_cache = 0; \
+		ring->head_cache = 0; \
+		return ring; \
+	} \
+	\
+	static inline u64 SPSC_fn(_ring_t, push_n)(SPSC(_ring_t)* restrict _ring, const _ring_t* restrict _vals, const u64 _n) \
+	{ \
+		const u64 tail = atomic_load_explicit(&_ring->tail, memory_order_relaxed); \
+		u64 room = (_ring->mask + 1) - (tail - _ring->head_cache); \
+		if (room < _n) { \
+			_ring->head_cache = atomic_load_explicit(&_ring->head, memory_order_acquire); \
+			room = (_ring->mask + 1) - (tail - _ring->head_cache); \
+		} \
+		const u64 n = (room < _n) ? room : _n; \
+		const u64 idx = tail & _ring->mask; \
+		const u64 first = (n < (_ring->mask + 1) - idx) ? n : (_ring->mask + 1) - idx; \
+		memcpy(_ring->buf + idx, _vals, first * sizeof(_ring_t)); \
+		memcpy(_ring->buf, _vals + first, (n - first) * sizeof(_ring_t)); \
+		atomic_store_explicit(&_ring->tail, tail + n, memory_order_release); \
+		return n; \
+	} \
+	\
+	static inline u64 SPSC_fn(_ring_t, pop_n)(SPSC(_ring_t)* restrict _ring, _ring_t* restrict _vals, const u64 _n) \
+	{ \
+		const u64 head = atomic_load_explicit(&_ring->head, memory_order_relaxed); \
+		u64 avail = _ring->tail_cache - head; \
+		if (avail < _n) { \
+			_ring->tail_cache = atomic_load_explicit(&_ring->tail, memory_order_acquire); \
+			avail = _ring->tail_cache - head; \
+		} \
+		const u64 n = (avail < _n) ? avail : _n; \
+		const u64 idx = head & _ring->mask; \
+		const u64 first = (n < (_ring->mask + 1) - idx) ? n : (_ring->mask + 1) - idx; \
+		memcpy(_vals, _ring->buf + idx, first * sizeof(_ring_t)); \
+		memcpy(_vals + first, _ring->buf, (n - first) * sizeof(_ring_t)); \
+		atomic_store_explicit(&_ring->head, head + n, memory_order_release); \
+		return n; \
+	} \
+	\
+	static inline bool SPSC_fn(_ring_t, push)(SPSC(_ring_t)* restrict _ring, const _ring_t* restrict _val) \
+	{ \
+		return SPSC_fn(_ring_t, push_n)(_ring, _val, 1) == 1; \
+	} \
+	\
+	static inline bool SPSC_fn(_ring_t, pop)(SPSC(_ring_t)* restrict _ring, _ring_t* restrict _val) \
+	{ \
+		return SPSC_fn(_ring_t, pop_n)(_ring, _val, 1) == 1; \
+	} \
+	\
+	static inline u64 SPSC_fn(_ring_t, len)(SPSC(_ring_t)* restrict _ring) \
+	{ \
+		return atomic_load(&_ring->tail) - atomic_load(&_ring->head); \
+	} \
+	\
+	static inline bool SPSC_fn(_ring_t, free)(SPSC(_ring_t)* restrict _ring) \
+	{ \
+		if (!_ring) return false; \
+		CT_FREE(_ring->buf); \
+		free(_ring); \
+		return true; \
+	}
+// End Ring_SPSC_t
+
+#define Ring_MPMC_t(_ring_t) \
+	typedef struct { \
+		atomic_ulong seq; \
+		_ring_t val; \
+	} mpmc_##_ring_t##_cell; \
+	\
+	typedef struct MPMC(_ring_t) { \
+		_Alignas(CACHE_LINE) atomic_ulong enqueue; \
+		_Alignas(CACHE_LINE) atomic_ulong dequeue; \
+		_Alignas(CACHE_LINE) u64 mask; \
+		mpmc_##_ring_t##_cell* buf; \
+	} MPMC(_ring_t); \
+	\
+	static inline MPMC(_ring_t)* MPMC_fn(_ring_t, create)(const u64 _capacity) \
+	{ \
+		/* aligned_alloc for the same reason as the SPSC header */ \
+		MPMC(_ring_t)* ring = (MPMC(_ring_t)*)aligned_alloc(CACHE_LINE, sizeof(MPMC(_ring_t))); \
+		if (!ring) return NULL; \
+		ring->mask = ring_capacity(_capacity) - 1; \
+		ring->buf = (mpmc_##_ring_t##_cell*)CT_MALLOC((ring->mask + 1) * sizeof(mpmc_##_ring_t##_cell)); \
+		if (!ring->buf) { free(ring); return NULL; } \
+		for ( u64 idx = 0; idx <= ring->mask; ++idx ) \
+			atomic_init(&ring->buf[idx].seq, idx); \
+		atomic_init(&ring->enqueue, 0); \
+		atomic_init(&ring->dequeue, 0); \
+		return ring; \
+	} \
+	\
+	static inline u64 MPMC_fn(_ring_t, push_n)(MPMC(_ring_t)* restrict _ring, const _ring_t* restrict _vals, const u64 _n) \
+	{ \
+		u64 pos = atomic_load_explicit(&_ring->enqueue, memory_order_relaxed); \
+		u64 n; \
+		for ( ;; ) { \
+			/* claim the run of free cells starting at pos in one CAS */ \
+			for ( n = 0; n < _n && n <= _ring->mask; ++n ) \
+				if (atomic_load_explicit(&_ring->buf[(pos + n) & _ring->mask].seq, memory_order_acquire) != pos + n) break; \
+			if (n == 0) { \
+				const u64 seq = atomic_load_explicit(&_ring->buf[pos & _ring->mask].seq, memory_order_acquire); \
+				if ((i64)(seq - pos) < 0) return 0; \
+				pos = atomic_load_explicit(&_ring->enqueue, memory_order_relaxed); \
+				continue; \
+			} \
+			if (atomic_compare_exchange_weak_explicit(&_ring->enqueue, &pos, pos + n, memory_order_relaxed, memory_order_relaxed)) break; \
+		} \
+		for ( u64 idx = 0; idx < n; ++idx ) { \
+			mpmc_##_ring_t##_cell* cell = &_ring->buf[(pos + idx) & _ring->mask]; \
+			cell->val = _vals[idx]; \
+			atomic_store_explicit(&cell->seq, pos + idx + 1, memory_order_release); \
+		} \
+		return n; \
+	} \
+	\
+	static inline u64 MPMC_fn(_ring_t, pop_n)(MPMC(_ring_t)* restrict _ring, _ring_t* restrict _vals, const u64 _n) \
+	{ \
+		u64 pos = atomic_load_explicit(&_ring->dequeue, memory_order_relaxed); \
+		u64 n; \
+		for ( ;; ) { \
+			for ( n = 0; n < _n && n <= _ring->mask; ++n ) \
+				if (atomic_load_explicit(&_ring->buf[(pos + n) & _ring->mask].seq, memory_order_acquire) != pos + n + 1) break; \
+			if (n == 0) { \
+				const u64 seq = atomic_load_explicit(&_ring->buf[pos & _ring->mask].seq, memory_order_acquire); \
+				if ((i64)(seq - (pos + 1)) < 0) return 0; \
+				pos = atomic_load_explicit(&_ring->dequeue, memory_order_relaxed); \
+				continue; \
+			} \
+			if (atomic_compare_exchange_weak_explicit(&_ring->dequeue, &pos, pos + n, memory_order_relaxed, memory_order_relaxed)) break; \
+		} \
+		for ( u64 idx = 0; idx < n; ++idx ) { \
+			mpmc_##_ring_t##_cell* cell = &_ring->buf[(pos + idx) & _ring->mask]; \
+			_vals[idx] = cell->val; \
+			atomic_store_explicit(&cell->seq, pos + idx + _ring->mask + 1, memory_order_release); \
+		} \
+		return n; \
+	} \
+	\
+	static inline bool MPMC_fn(_ring_t, push)(MPMC(_ring_t)* restrict _ring, const _ring_t* restrict _val) \
+	{ \
+		return MPMC_fn(_ring_t, push_n)(_ring, _val, 1) == 1; \
+	} \
+	\
+	static inline bool MPMC_fn(_ring_t, pop)(MPMC(_ring_t)* restrict _ring, _ring_t* restrict _val) \
+	{ \
+		return MPMC_fn(_ring_t, pop_n)(_ring, _val, 1) == 1; \
+	} \
+	\
+	static inline bool MPMC_fn(_ring_t, free)(MPMC(_ring_t)* restrict _ring) \
+	{ \
+		if (!_ring) return false; \
+		CT_FREE(_ring->buf); \
+		free(_ring); \
+		return true; \
+	}
+// End Ring_MPMC_t
+
+#define Ring_t(_ring_t) \
+	Ring_SPSC_t(_ring_t) \
+	Ring_MPMC_t(_ring_t)
+// End Ring_t
+
+#define Ring_Named_t(_ring_t, _ring_n) \
+	typedef _ring_t _ring_n; \
+	Ring_t(_ring_n)
+// End Ring_Named_t
+
+/*
+ | Declaring common datatypes
+*/
+Ring_t(u64)
+Ring_t(SS_t)
+Ring_Named_t(String_t*, String_ptr)
+
+#endif // End _CT_STL_RING_BUFFER_H
@@ -4,16 +4,20 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "types.h"
 #include "todo.h"
 #include "bit_manip.h"
 #include "optional.h"
+#include "alloc.h"
 
 #define Stack_Size 32
 
-static char TmpStringBuf[Stack_Size];
-
 typedef union SS_t { 
 	char data[Stack_Size]; 
 } SS_t;
@@ -32,33 +36,67 @@ typedef struct StackString {
 	const bool	   (*slice)(SS_t* restrict, const register u16, const register u16);
 	Optional(SS_t) (*owned_slice)(SS_t* restrict, const register u16, const register u16);
 	const bool	   (*append)(SS_t* restrict, const char* restrict);
+	const bool	   (*append_n)(SS_t* restrict, const char* restrict, const register u64);
 	const bool	   (*insert)(SS_t* restrict, const char* restrict, const register u16);
 	const bool	   (*toupper)(SS_t* restrict);
 	const bool	   (*tolower)(SS_t* restrict);
 	Optional(u16)  (*find)(const SS_t* restrict, const char* restrict);
+	i32			   (*cmp)(const SS_t*, const SS_t*);
+	const bool	   (*eq)(const SS_t*, const SS_t*);
 	const bool	   (*replace)(SS_t* restrict, const char, const register u16 _idx);
 	const bool	   (*strip)(SS_t* restrict, const char*);
 	const bool	   (*clear)(SS_t* restrict);
 } StackString;
 
-Optional(SS_t) StackString_owned_from(const char* restrict _str)
+/*
+ | Literal constructors, the length byte is derived from sizeof and the whole value is a constant
+ | SS_INIT is for static storage (static SS_t key = SS_INIT("key");), SS_lit yields an SS_t value
+ | Both reject non-literals and literals longer than Stack_Size-1 at compile time
+ | Every byte gets exactly one initializer, so the length byte never overrides the literal and
+ | -Woverride-init stays quiet
+*/
+// past the end of the literal a byte is 0, the index is clamped so it never reads past the literal
+#define SS_LIT_CHAR(_s, _i) \
+	((char)(((_i) < sizeof(_s) - 1) ? (_s)[((_i) < sizeof(_s)) ? (_i) : 0] : 0))
+// End SS_LIT_CHAR
+
+#define SS_LIT_CHAR8(_s, _i) \
+	SS_LIT_CHAR(_s, (_i)+0), SS_LIT_CHAR(_s, (_i)+1), SS_LIT_CHAR(_s, (_i)+2), SS_LIT_CHAR(_s, (_i)+3), \
+	SS_LIT_CHAR(_s, (_i)+4), SS_LIT_CHAR(_s, (_i)+5), SS_LIT_CHAR(_s, (_i)+6), SS_LIT_CHAR(_s, (_i)+7)
+// End SS_LIT_CHAR8
+
+_Static_assert(Stack_Size == 32, "SS_INIT spells out one initializer per byte of a 32 byte SS_t");
+
+#define SS_INIT(_s) \
+	{ .data = { \
+		SS_LIT_CHAR8("" _s "", 0), SS_LIT_CHAR8(_s, 8), SS_LIT_CHAR8(_s, 16), \
+		SS_LIT_CHAR(_s, 24), SS_LIT_CHAR(_s, 25), SS_LIT_CHAR(_s, 26), SS_LIT_CHAR(_s, 27), \
+		SS_LIT_CHAR(_s, 28), SS_LIT_CHAR(_s, 29), SS_LIT_CHAR(_s, 30), \
+		(Stack_Size - (sizeof(_s) - 1)) + 0 * sizeof(char[(sizeof(_s) <= Stack_Size) ? 1 : -1]) } }
+// End SS_INIT
+
+#define SS_lit(_s) ((SS_t)SS_INIT(_s))
+
+CT_API Optional(SS_t) StackString_owned_from(const char* restrict _str)
 /*
  | Returns an optionally owned StackString initialized with the given _str
 */
 {	
 	if (!_str) return None(SS_t);
-	const register u16 _str_len = strlen(_str);
-	if (_str_len > Stack_Size) return None(SS_t);
+	const u64 _str_len = strlen(_str);
+	// the last byte holds the length, so at most Stack_Size-1 characters fit
+	if (_str_len > Stack_Size - 1) return None(SS_t);
 
 	SS_t string;
 
-	if(!strncpy(string.data, _str, _str_len)) return None(SS_t);	
+	memcpy(string.data, _str, _str_len);
+	if (_str_len < Stack_Size - 1) string.data[_str_len] = '\0';
 	string.data[Stack_Size-1] = (Stack_Size - _str_len);
 
 	return Some(SS_t, string);
 }
 
-const u16 StackString_len(const SS_t* restrict _string)
+CT_API const u16 StackString_len(const SS_t* restrict _string)
 /*
  | Returns the length of the string within the StackString 
 */
@@ -66,12 +104,12 @@ const u16 StackString_len(const SS_t* restrict _string)
 	return _string ? (Stack_Size - _string->data[Stack_Size-1]) : -1;
 }
 
-const u16 StackString_mem_size(const SS_t* restrict _string)
+CT_API const u16 StackString_mem_size(const SS_t* restrict _string)
 {
 	return _string ? Stack_Size : -1;
 }
 
-char* StackString_cstr(SS_t* restrict _string)
+CT_API char* StackString_cstr(SS_t* restrict _string)
 /*
  | Returns a pointer to the string stored within the given StackString
 */
@@ -79,26 +117,29 @@ char* StackString_cstr(SS_t* restrict _string)
 	return _string ? _string->data : NULL;
 }
 
-char* StackString_owned_cstr(const SS_t* restrict _string)
+CT_API char* StackString_owned_cstr(const SS_t* restrict _string)
 /*
  | Returns a pointer to a copy of the string stored in the given StackString
 */
 {
+	if (!_string) return NULL;
 	const register u16 _string_len = StackString_len(_string);
-	char* cstr_buf = (char*)malloc(_string_len+1);
-	strncpy(cstr_buf, _string->data, _string_len);
+	char* cstr_buf = (char*)CT_MALLOC(_string_len+1);
+	if (!cstr_buf) return NULL;
+	memcpy(cstr_buf, _string->data, _string_len);
+	cstr_buf[_string_len] = '\0';
 	return cstr_buf;
 }
 
-char* StackString_at(SS_t* restrict _string, const register u16 _idx)
+CT_API char* StackString_at(SS_t* restrict _string, const register u16 _idx)
 /*
  | Returns a pointer to the given SS at the given _idx
 */
 {
-	return (_string || _idx > StackString_len(_string)) ? &_string->data[_idx] : NULL;
+	return (_string && _idx < StackString_len(_string)) ? &_string->data[_idx] : NULL;
 }
 
-char* StackString_begin(SS_t* restrict _string)
+CT_API char* StackString_begin(SS_t* restrict _string)
 /*
  | Returns a pointer to the begining of the given SS
 */
@@ -106,7 +147,7 @@ char* StackString_begin(SS_t* restrict _string)
 	return (_string) ? &_string->data[0] : NULL;
 }
 
-char* StackString_end(SS_t* restrict _string)
+CT_API char* StackString_end(SS_t* restrict _string)
 /*
  | Returns a pointer to the end of the given SS
 */
@@ -114,68 +155,81 @@ char* StackString_end(SS_t* restrict _string)
 	return (_string) ? &_string->data[StackString_len(_string)] : NULL;
 }
 
-const bool StackString_slice(SS_t* restrict _string, const register u16 _start, const register u16 _end)
+CT_API const bool StackString_slice(SS_t* restrict _string, const register u16 _start, const register u16 _end)
 /*
- | Slices the string in the given StackString to the starting and ending indicies
+ | Slices the string in the given StackString down to the characters in [_start, _end)
 */
 {
-	if (_end > StackString_len(_string) || _end+_start > StackString_len(_string) || _start < 0 ) return false;
-	for ( u16 idx = 0; idx <= _end; ++idx)
-		_string->data[idx] = _string->data[idx+_start];
-	_string->data[_end+1] = '\0';
+	if (!_string || _start > _end || _end > StackString_len(_string)) return false;
+	memmove(_string->data, _string->data+_start, _end - _start);
+	_string->data[_end - _start] = '\0';
 
-	_string->data[Stack_Size-1] = (_end - _start);
+	_string->data[Stack_Size-1] = (Stack_Size - (_end - _start));
 
 	return true;
 }
 
-Optional(SS_t) StackString_owned_slice(SS_t* restrict _string, const register u16 _start, const register u16 _end)
+CT_API Optional(SS_t) StackString_owned_slice(SS_t* restrict _string, const register u16 _start, const register u16 _end)
 /*
- | Slices the string in the given StackString given the starting and ending indicies and returns an pointer to an owned optional StackString
+ | Returns an owned optional StackString holding the characters of the given StackString in [_start, _end)
 */
 {
-	if (_end > StackString_len(_string) || _end > StackString_len(_string) || _start < 0 ) return None(SS_t);
+	if (!_string || _start > _end || _end > StackString_len(_string)) return None(SS_t);
 	SS_t new_string;
-	strncpy(new_string.data, _string->data+_start, _end);
+	memcpy(new_string.data, _string->data+_start, _end - _start);
+	new_string.data[_end - _start] = '\0';
 
-	new_string.data[Stack_Size-1] = (_end - _start);
+	new_string.data[Stack_Size-1] = (Stack_Size - (_end - _start));
 
 	return Some(SS_t, new_string);
 }
 
-const bool StackString_append(SS_t* restrict _string, const char* restrict _str)
+CT_API const bool StackString_append_n(SS_t* restrict _string, const char* restrict _str, const register u64 _str_len)
 /*
- | Appends a string to the end of the given Stack String
+ | Appends _str_len bytes to the given Stack String, the last byte stays reserved for the length
 */
 {
-	const register u16 _str_len = strlen(_str);
-	const register u16 old_len = StackString_len(_string); 
-	if ((StackString_len(_string) + _str_len) > Stack_Size) return false;
-	if (!strncat(_string->data, _str, _str_len)) return false;
-	_string->data[Stack_Size-1] = (Stack_Size - (_str_len + old_len));
+	if (!_string || !_str) return false;
+	const register u16 old_len = StackString_len(_string);
+	if (old_len + _str_len > Stack_Size - 1) return false;
+
+	memcpy(_string->data + old_len, _str, _str_len);
+	if (old_len + _str_len < Stack_Size - 1) _string->data[old_len + _str_len] = '\0';
+	_string->data[Stack_Size-1] = (Stack_Size - (old_len + _str_len));
 
 	return true;
 }
 
-const bool StackString_insert(SS_t* restrict _string, const char* restrict _str, const register u16 _idx)
+CT_API const bool StackString_append(SS_t* restrict _string, const char* restrict _str)
+/*
+ | Appends a string to the end of the given Stack String
+*/
+{
+	if (!_str) return false;
+	return StackString_append_n(_string, _str, strlen(_str));
+}
+
+CT_API const bool StackString_insert(SS_t* restrict _string, const char* restrict _str, const register u16 _idx)
 /*
  | Inserts a string into the given Stack String at a specified index
 */
 {
-	const register u16 _str_len = strlen(_str);
-	const register u16 new_len = StackString_len(_string) + _str_len;
-	if (StackString_len(_string + _str_len) > Stack_Size) return false;	
-	
-	strncpy(TmpStringBuf, _string->data+_idx, (StackString_len(_string) - _idx));
-	strncpy(_string->data+_idx, _str, _str_len);
-	strncpy(_string->data+(_idx+_str_len), TmpStringBuf, new_len);
+	if (!_string || !_str) return false;
+	const register u16 _string_len = StackString_len(_string);
+	const u64 _str_len = strlen(_str);
+	if (_idx > _string_len || _string_len + _str_len > Stack_Size - 1) return false;
+	const register u16 new_len = _string_len + _str_len;
+
+	memmove(_string->data+(_idx+_str_len), _string->data+_idx, _string_len - _idx);
+	memcpy(_string->data+_idx, _str, _str_len);
+	if (new_len < Stack_Size - 1) _string->data[new_len] = '\0';
 
 	_string->data[Stack_Size-1] = (Stack_Size - new_len);
 
 	return true;
 }
 
-const bool StackString_toupper(SS_t* restrict _string)
+CT_API const bool StackString_toupper(SS_t* restrict _string)
 /*
  | Converts the given string to all uppercase characters
  | Can be optimized in the future using SIMD instructions
@@ -183,42 +237,48 @@ const bool StackString_toupper(SS_t* restrict _string)
 {
 
 	if (!_string) return false;
-	char curr;
-	for ( u16 idx = 0; (curr = _string->data[idx]) != '\0'; ++idx )
+	const register u16 _string_len = StackString_len(_string);
+	for ( u16 idx = 0; idx < _string_len; ++idx ) {
+		const char curr = _string->data[idx];
 		_string->data[idx] = (curr >= 97 && curr <= 122 ) ? curr-32 : curr;
+	}
 	return true;
 }
 
-const bool StackString_tolower(SS_t* restrict _string)
+CT_API const bool StackString_tolower(SS_t* restrict _string)
 /*
  | Converts the given string to all lowercase characters
 */
 {
 	if (!_string) return false;
-	char curr;
-	for ( u16 idx = 0; (curr = _string->data[idx]) != '\0'; ++idx )
+	const register u16 _string_len = StackString_len(_string);
+	for ( u16 idx = 0; idx < _string_len; ++idx ) {
+		const char curr = _string->data[idx];
 		_string->data[idx] = (curr >= 65 && curr <= 90 ) ? curr+32 : curr;
+	}
 	return true;
 }
 
-static void StackString_compute_lps(const char* _pattern, const u16 _pattern_len)
+static void StackString_compute_lps(const char* _pattern, const u16 _pattern_len, u8* _lps)
 {
 	/*
-	 | In this case TmpStringBuf will serve double duty by storing all of the prefix indicies
+	 | _lps[i] is the length of the longest proper prefix of _pattern[0..i] that is also its suffix
+	 | The table lives on the caller's stack, so concurrent finds never share it
 	*/
 	u16 prev_suffix_len = 0;
+	_lps[0] = 0;
 	
 	u16 i = 1;
 	while ( i < _pattern_len ) {
-		if (_pattern[i] == _pattern[_pattern_len]) {
-			TmpStringBuf[i] = ++prev_suffix_len;
+		if (_pattern[i] == _pattern[prev_suffix_len]) {
+			_lps[i] = ++prev_suffix_len;
 			i++;
 		
 		} else {
 			if (prev_suffix_len != 0)
-				prev_suffix_len = TmpStringBuf[prev_suffix_len-1];
+				prev_suffix_len = _lps[prev_suffix_len-1];
 			else {
-				TmpStringBuf[i] = 0;
+				_lps[i] = 0;
 				i++;
 			}
 		}
@@ -231,9 +291,13 @@ static Optional(u16) string_find(const char* restrict _haystack, const char* res
  | using an implementation of the KMP search algorigthm: https://en.wikipedia.org/wiki/Knuth%E2%80%93Morris%E2%80%93Pratt_algorithm
 */
 {
-	const u16 _needle_len = strlen(_needle);
+	const u64 _needle_len = strlen(_needle);
+	if (_needle_len == 0) return Some(u16, 0);
+	if (_needle_len > _haystack_len) return None(u16);
 
-	StackString_compute_lps(_haystack, _haystack_len);
+	// a needle that fits in the haystack is shorter than Stack_Size
+	u8 lps[Stack_Size];
+	StackString_compute_lps(_needle, _needle_len, lps);
 
 	u16 _haystack_idx = 0; 
 	u16 _needle_idx = 0;
@@ -241,79 +305,144 @@ static Optional(u16) string_find(const char* restrict _haystack, const char* res
 		if (_needle[_needle_idx] == _haystack[_haystack_idx]) {
 			++_haystack_idx;
 			++_needle_idx;
-		}
-		if (_needle_idx == _needle_len) {
-			return Some(u16, (_haystack_idx - _needle_idx));
-			_needle_idx = TmpStringBuf[_needle_idx-1];
+			if (_needle_idx == _needle_len) return Some(u16, (_haystack_idx - _needle_idx));
 		
-		} else if (_haystack_idx < _haystack_len && _needle[_needle_idx] != _haystack[_haystack_idx]) {
-			if (_needle_idx != 0)
-				_needle_idx = TmpStringBuf[_needle_idx-1];
-			else
-				_haystack_idx++;
-		}
+		} else if (_needle_idx != 0)
+			_needle_idx = lps[_needle_idx-1];
+		else
+			_haystack_idx++;
 	}
 
 	return None(u16);
 }
 
-Optional(u16) StackString_find(const SS_t* restrict _haystack, const char* restrict _needle)
+CT_API Optional(u16) StackString_find(const SS_t* restrict _haystack, const char* restrict _needle)
 {
+	if (!_haystack || !_needle) return None(u16);
 	return string_find(_haystack->data, _needle, StackString_len(_haystack));
 }
 
-const bool StackString_remove(SS_t* restrict _string, const char* _str)
+_Static_assert(Stack_Size == 32, "StackString_eq_mask compares the whole SS_t as one 32 byte block");
+
+static inline u32 StackString_eq_mask(const SS_t* _a, const SS_t* _b)
+/*
+ | Bit i is set when byte i of the two unions matches, the length byte lands in bit Stack_Size-1
+ | With AVX2 the whole SS_t is one load and one compare per side
+*/
+{
+#if defined(__AVX2__)
+	return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i*)_a->data), _mm256_loadu_si256((const __m256i*)_b->data)));
+#elif defined(__SSE2__)
+	const u32 lo = _mm_movemask_epi8(_mm_cmpeq_epi8(
+			_mm_loadu_si128((const __m128i*)_a->data), _mm_loadu_si128((const __m128i*)_b->data)));
+	const u32 hi = _mm_movemask_epi8(_mm_cmpeq_epi8(
+			_mm_loadu_si128((const __m128i*)(_a->data+16)), _mm_loadu_si128((const __m128i*)(_b->data+16))));
+	return lo | (hi << 16);
+#else
+	u32 mask = 0;
+	for ( u16 idx = 0; idx < Stack_Size; ++idx ) mask |= (u32)(_a->data[idx] == _b->data[idx]) << idx;
+	return mask;
+#endif
+}
+
+CT_API const bool StackString_eq(const SS_t* _a, const SS_t* _b)
+/*
+ | Equal when the length bytes match and so do the first len bytes, whatever sits past len is ignored
+*/
+{
+	const u16 _len = StackString_len(_a);
+	const u32 needed = ((1U << _len) - 1) | (1U << (Stack_Size-1));
+	return (StackString_eq_mask(_a, _b) & needed) == needed;
+}
+
+CT_API i32 StackString_cmp(const SS_t* _a, const SS_t* _b)
+/*
+ | Lexicographic byte order like memcmp, the first differing byte comes straight out of the compare mask
+*/
+{
+	const u16 _a_len = StackString_len(_a);
+	const u16 _b_len = StackString_len(_b);
+	const u16 min_len = (_a_len < _b_len) ? _a_len : _b_len;
+	if (min_len >= 8) {
+		// most pairs differ in their first 8 bytes, settle those with one big-endian compare
+		u64 a_head;
+		u64 b_head;
+		memcpy(&a_head, _a->data, 8);
+		memcpy(&b_head, _b->data, 8);
+		if (a_head != b_head) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			a_head = __builtin_bswap64(a_head);
+			b_head = __builtin_bswap64(b_head);
+#endif
+			return (a_head > b_head) ? 1 : -1;
+		}
+	}
+
+	const u32 diff = ~StackString_eq_mask(_a, _b) & ((1U << min_len) - 1);
+	if (diff) {
+		const u32 idx = __builtin_ctz(diff);
+		return (i32)(u8)_a->data[idx] - (i32)(u8)_b->data[idx];
+	}
+	return (_a_len > _b_len) - (_a_len < _b_len);
+}
+
+CT_API const bool StackString_remove(SS_t* restrict _string, const char* _str)
 /*
  | Removes all instances of a substr
- | Credit: chqrlie
- | Source: https://stackoverflow.com/questions/47116974/remove-a-substring-from-a-string-in-c
- | In the future, replace strstr with StackString_find
+ | Compacts in place over the stored length, a full StackString has no NUL for strstr to stop at
 */
 {
-	const u16 _str_len = strlen(_str);
-	const u16 _string_len = StackString_len(_string);
+	if (!_string || !_str || !*_str) return false;
+	const u64 _str_len = strlen(_str);
+	const register u16 _string_len = StackString_len(_string);
 	
-	char *p, *q, *r;
-	if (*_str && (q = r = strstr(_string->data, _str))) {
-		while ( (r = strstr(p = r + _str_len, _str)) != NULL ) {
-			while ( p < r ) *q++ = *p++;
-		}
-		while ( (*q++ = *p++) != '\0')
+	u16 kept = 0;
+	for ( u16 idx = 0; idx < _string_len; ) {
+		if (idx + _str_len <= _string_len && memcmp(_string->data+idx, _str, _str_len) == 0) {
+			idx += _str_len;
 			continue;
+		}
+		_string->data[kept++] = _string->data[idx++];
 	}
+	if (kept < Stack_Size - 1) _string->data[kept] = '\0';
 
-	_string->data[Stack_Size-1] = (Stack_Size - strlen(_string->data));
+	_string->data[Stack_Size-1] = (Stack_Size - kept);
 	return true;
 }
 
-const bool StackString_replace(SS_t* restrict _string, const char _c, const register u16 _idx)
+CT_API const bool StackString_replace(SS_t* restrict _string, const char _c, const register u16 _idx)
 /*
  | Replaces the string at _idx with character _c
 */
 {
-	const u16 _string_len = StackString_len(_string);
-	if (_idx > _string_len) return false;
+	if (!_string || _idx >= StackString_len(_string)) return false;
 	_string->data[_idx] = _c;
 	return true;
 }
 
-const bool StackString_strip(SS_t* restrict _string, const char* _delim)
+CT_API const bool StackString_strip(SS_t* restrict _string, const char* _delim)
 /*
  | Removes all instances of each character in _delim
 */
 {
-	TmpStringBuf[1] = '\0';
-	for ( ; *_delim != '\0'; _delim++ ) {
-		TmpStringBuf[0] = *_delim;
-		if (!StackString_remove(_string, TmpStringBuf)) return false;
+	if (!_string || !_delim) return false;
+	const register u16 _string_len = StackString_len(_string);
+
+	u16 kept = 0;
+	for ( u16 idx = 0; idx < _string_len; ++idx ) {
+		const char curr = _string->data[idx];
+		_string->data[kept] = curr;
+		kept += (strchr(_delim, curr) == NULL || curr == '\0');
 	}
-	
-	_string->data[Stack_Size-1] = (Stack_Size - strlen(_string->data));
+	if (kept < Stack_Size - 1) _string->data[kept] = '\0';
+
+	_string->data[Stack_Size-1] = (Stack_Size - kept);
 
 	return true;
 }
 
-const bool StackString_clear(SS_t* restrict _string)
+CT_API const bool StackString_clear(SS_t* restrict _string)
 /*
  | Clears the given string
 */
@@ -324,16 +453,17 @@ const bool StackString_clear(SS_t* restrict _string)
 	return true;
 }
 
-void StackString_dump(const SS_t* restrict _string)
+CT_API void StackString_dump(const SS_t* restrict _string)
 {
-	printf("String: %s\nLength: %u\nSize: %u\n",
+	printf("String: %.*s\nLength: %u\nSize: %u\n",
+			(int)StackString_len(_string),
 			_string->data,
 			StackString_len(_string),
 			StackString_mem_size(_string)
 			);	
 }
 
-StackString SS = {
+const static StackString SS = {
 	StackString_owned_from,
 	StackString_len,
 	StackString_mem_size,
@@ -345,10 +475,13 @@ StackString SS = {
 	StackString_slice,
 	StackString_owned_slice,
 	StackString_append,
+	StackString_append_n,
 	StackString_insert,
 	StackString_toupper,
 	StackString_tolower,
 	StackString_find,
+	StackString_cmp,
+	StackString_eq,
 	StackString_replace,
 	StackString_strip,
 	StackString_clear,
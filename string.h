@@ -2,8 +2,14 @@
 #define _CT_STL_STRING_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "bit_manip.h"
 #include "optional.h"
@@ -13,8 +19,14 @@
 
 #define MEM_ALIGNMENT 32
 
-static char DELIM_BUF[2];
+// patterns up to this many bytes that alias their own string are copied to the stack, not the heap
+#define STRING_PATTERN_BUF 64
 
+/*
+ | len is authoritative: data may hold any bytes, embedded NULs included, and every operation is
+ | length driven (memcpy / memmove / string_memfind), data[len] is still kept '\0' so cstr stays
+ | usable on text, C string arguments are measured once with strlen and have _n variants
+*/
 typedef struct String_t {
 	char* data;
 	u64 size;
@@ -23,10 +35,151 @@ typedef struct String_t {
 
 Optional_t(String_t);
 
+static const char* string_memfind(const char* restrict _haystack, const u64 _haystack_len, const char* restrict _needle, const u64 _needle_len)
+/*
+ | Length driven substring search, returns a pointer to the first match or NULL
+ | With SSE2 16 candidate positions are filtered at once by comparing both the needle's first and
+ | last byte, only positions passing both get a memcmp, the scalar tail / fallback uses memchr
+*/
+{
+	if (_needle_len == 0) return _haystack;
+	if (_needle_len > _haystack_len) return NULL;
+	if (_needle_len == 1) return (const char*)memchr(_haystack, _needle[0], _haystack_len);
+
+	u64 idx = 0;
+	const u64 n_positions = _haystack_len - _needle_len + 1;
+#ifdef __AVX2__
+	const __m256i first_wide = _mm256_set1_epi8(_needle[0]);
+	const __m256i last_wide = _mm256_set1_epi8(_needle[_needle_len-1]);
+	// two blocks per trip so the common no-candidate case costs one branch per 64 positions
+	for ( ; idx + 64 <= n_positions; idx += 64 ) {
+		const __m256i lo = _mm256_and_si256(
+			_mm256_cmpeq_epi8(first_wide, _mm256_loadu_si256((const __m256i*)(_haystack + idx))),
+			_mm256_cmpeq_epi8(last_wide, _mm256_loadu_si256((const __m256i*)(_haystack + idx + _needle_len - 1))));
+		const __m256i hi = _mm256_and_si256(
+			_mm256_cmpeq_epi8(first_wide, _mm256_loadu_si256((const __m256i*)(_haystack + idx + 32))),
+			_mm256_cmpeq_epi8(last_wide, _mm256_loadu_si256((const __m256i*)(_haystack + idx + 32 + _needle_len - 1))));
+		if (_mm256_testz_si256(_mm256_or_si256(lo, hi), _mm256_or_si256(lo, hi))) continue;
+
+		u64 mask = (u64)(u32)_mm256_movemask_epi8(lo) | ((u64)(u32)_mm256_movemask_epi8(hi) << 32);
+		while ( mask ) {
+			const u32 bit = __builtin_ctzll(mask);
+			if (memcmp(_haystack + idx + bit + 1, _needle + 1, _needle_len - 2) == 0) return _haystack + idx + bit;
+			mask &= mask - 1;
+		}
+	}
+	for ( ; idx + 32 <= n_positions; idx += 32 ) {
+		const __m256i block_first = _mm256_loadu_si256((const __m256i*)(_haystack + idx));
+		const __m256i block_last = _mm256_loadu_si256((const __m256i*)(_haystack + idx + _needle_len - 1));
+		u32 mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first_wide, block_first), _mm256_cmpeq_epi8(last_wide, block_last)));
+		while ( mask ) {
+			const u32 bit = __builtin_ctz(mask);
+			if (memcmp(_haystack + idx + bit + 1, _needle + 1, _needle_len - 2) == 0) return _haystack + idx + bit;
+			mask &= mask - 1;
+		}
+	}
+#endif
+#ifdef __SSE2__
+	const __m128i first = _mm_set1_epi8(_needle[0]);
+	const __m128i last = _mm_set1_epi8(_needle[_needle_len-1]);
+	for ( ; idx + 16 <= n_positions; idx += 16 ) {
+		const __m128i block_first = _mm_loadu_si128((const __m128i*)(_haystack + idx));
+		const __m128i block_last = _mm_loadu_si128((const __m128i*)(_haystack + idx + _needle_len - 1));
+		u32 mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+		while ( mask ) {
+			const u32 bit = __builtin_ctz(mask);
+			if (memcmp(_haystack + idx + bit + 1, _needle + 1, _needle_len - 2) == 0) return _haystack + idx + bit;
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	const char* curr = _haystack + idx;
+	const char* end = _haystack + n_positions;
+	while ( curr < end ) {
+		curr = (const char*)memchr(curr, _needle[0], end - curr);
+		if (!curr) return NULL;
+		if (memcmp(curr + 1, _needle + 1, _needle_len - 1) == 0) return curr;
+		++curr;
+	}
+
+	return NULL;
+}
+
+/*
+ | Buffer ownership
+ | Built with -DCT_STRING_COW every buffer carries an atomic refcount in a header in front of data,
+ | String.share hands out another String_t over the same bytes and each mutator first calls
+ | String.make_unique, which copies only while the buffer is actually shared
+ | Without the flag buffers are plain allocations and share falls back to a deep copy
+ | Raw pointers from cstr / at / begin / end bypass this, call make_unique before writing through them
+ | In this mode data must come from a String constructor and go back through String.free / free_owned
+*/
+#ifdef CT_STRING_COW
+#include <stdatomic.h>
+
+typedef struct String_buf_t {
+	atomic_ulong refs;
+	u64 reserved; // keeps data 16 byte aligned
+} String_buf_t;
+
+static inline String_buf_t* string_buf(const char* _data)
+{
+	return ((String_buf_t*)_data) - 1;
+}
+
+static inline char* string_buf_alloc(const u64 _size)
+{
+	String_buf_t* buf = (String_buf_t*)CT_MALLOC(sizeof(String_buf_t) + _size);
+	if (!buf) return NULL;
+	atomic_init(&buf->refs, 1);
+	return (char*)(buf + 1);
+}
+
+static inline char* string_buf_realloc(char* _data, const u64 _size)
+{
+	if (!_data) return string_buf_alloc(_size);
+	String_buf_t* buf = (String_buf_t*)CT_REALLOC(string_buf(_data), sizeof(String_buf_t) + _size);
+	return buf ? (char*)(buf + 1) : NULL;
+}
+
+static inline void string_buf_release(char* _data)
+{
+	if (!_data) return;
+	String_buf_t* buf = string_buf(_data);
+	if (atomic_fetch_sub_explicit(&buf->refs, 1, memory_order_acq_rel) == 1) CT_FREE(buf);
+}
+#else
+#define string_buf_alloc(_size) ((char*)CT_MALLOC((_size)))
+#define string_buf_realloc(_data, _size) ((char*)CT_REALLOC((_data), (_size)))
+#define string_buf_release(_data) CT_FREE((_data))
+#endif // End CT_STRING_COW
+
+static inline u64 string_alias_offset(const String_t* _string, const char* _ptr)
+/*
+ | Offset of _ptr into _string's buffer, _string->size or more when it points elsewhere
+ | Worked out on integers up front, so no pointer difference is left to span a later realloc
+ | A string without a buffer has size 0, so nothing aliases it
+*/
+{
+	return (u64)((uintptr_t)_ptr - (uintptr_t)_string->data);
+}
+
+static inline const bool string_aliases(const String_t* _string, const char* _ptr)
+/*
+ | True when _ptr points into _string's buffer, such a source has to be located again by
+ | offset once make_unique or resize may have moved the buffer
+*/
+{
+	return string_alias_offset(_string, _ptr) < _string->size;
+}
+
 struct String_funcs {
 	// String_t creation
 	Optional(String_t)	(*owned_from)(const char* restrict);
+	Optional(String_t)	(*owned_from_n)(const char* restrict, const register u64);
 	String_t*			(*from)(const char* restrict);
+	String_t*			(*from_n)(const char* restrict, const register u64);
 	String_t*			(*from_file)(FILE* restrict);
 	Optional(String_t)	(*owned_slice_from)(const char* restrict, const register u64, const register u64);
 	String_t*			(*slice_from)(const char* restrict, const register u64, const register u64);
@@ -39,6 +192,7 @@ struct String_funcs {
 
 	// string manipulation functions
 	const bool	(*append)(String_t*, const char*);
+	const bool	(*append_n)(String_t*, const char*, const register u64);
 	const bool	(*append_str)(String_t*, const String_t*);
 	const bool	(*append_file)(String_t*, FILE* restrict);
 	char*		(*at)(const String_t*, const register u64);
@@ -46,17 +200,24 @@ struct String_funcs {
 	char*		(*end)(const String_t*);
 	const bool	(*slice)(String_t*, const register u64, const register u64);
 	const bool	(*remove)(String_t*, const char*); 
+	const bool	(*remove_all)(String_t*, const char*);
 	const bool	(*remove_slice)(String_t*, const register u64, const register u64);
 	const bool	(*strip)(String_t*, const char*);
 	const bool	(*insert)(String_t*, const char*, const register u64);
+	const bool	(*insert_n)(String_t*, const char*, const register u64, const register u64);
 	const bool	(*insert_str)(String_t*, const String_t*, const register u64);
 	const bool	(*replace)(String_t*, const char, const register u64);
+	const bool	(*replace_all)(String_t*, const char*, const char*);
+	const bool	(*replace_all_n)(String_t*, const char*, const register u64, const char*, const register u64);
 	const bool	(*rev)(String_t*);
 	const bool	(*toupper)(String_t*);
 	const bool	(*tolower)(String_t*);
 
 	// search / algo methods
 	Optional(u64) (*find)(const String_t*, const char*);
+	Optional(u64) (*find_n)(const String_t*, const char*, const register u64);
+	i32			(*cmp)(const String_t*, const String_t*);
+	const bool	(*eq)(const String_t*, const String_t*);
 
 	// memory methods
 	const bool	(*resize)(String_t* restrict, const register u64);
@@ -64,178 +225,302 @@ struct String_funcs {
 	const bool	(*clear)(String_t* restrict);
 	const bool	(*free)(String_t* restrict);
 	const bool	(*free_owned)(String_t* restrict);
+	Optional(String_t)	(*share)(const String_t* restrict);
+	u64			(*refs)(const String_t* restrict);
+	const bool	(*make_unique)(String_t* restrict);
 };
 
-const bool String_resize(String_t* restrict _string, const register u64 _size)
+CT_API const bool String_make_unique(String_t* restrict _string)
+/*
+ | Gives _string a buffer of its own ahead of a mutation, copying only if the buffer is shared
+*/
 {
+	CT_INSTRUMENT_FN("String.make_unique");
 	if (!_string) return false;
+#ifdef CT_STRING_COW
+	if (!_string->data || atomic_load_explicit(&string_buf(_string->data)->refs, memory_order_acquire) == 1) return true;
+
+	char* data = string_buf_alloc(_string->size);
+	if (!data) return false;
+	const u64 copy_len = (_string->len < _string->size) ? _string->len + 1 : _string->size;
+	memcpy(data, _string->data, copy_len);
+	CT_COPIED(copy_len);
+
+	string_buf_release(_string->data);
+	_string->data = data;
+#endif
+	return true;
+}
+
+CT_API u64 String_refs(const String_t* restrict _string)
+/*
+ | Number of String_t handles sharing _string's buffer, always 1 without CT_STRING_COW
+*/
+{
+	if (!_string || !_string->data) return 0;
+#ifdef CT_STRING_COW
+	return atomic_load_explicit(&string_buf(_string->data)->refs, memory_order_acquire);
+#else
+	return 1;
+#endif
+}
+
+CT_API const bool String_resize(String_t* restrict _string, const register u64 _size)
+{
+	CT_INSTRUMENT_FN("String.resize");
+	if (!String_make_unique(_string)) return false;
 	_string->size = mem_round(_string->size+_size, MEM_ALIGNMENT);
-	_string->data = (char*)realloc(_string->data, _string->size);
+	_string->data = string_buf_realloc(_string->data, _string->size);
 	if (!_string->data) return false;
 
 	return true;
 }
 
-const bool String_shrink(String_t* restrict _string)
+CT_API const bool String_shrink(String_t* restrict _string)
 {
-	if (!_string) return false;
-	_string->size = _string->len;
-	_string->data = (char*)realloc(_string->data, _string->len);
+	CT_INSTRUMENT_FN("String.shrink");
+	if (!String_make_unique(_string)) return false;
+	// keep one byte past len for the terminating NUL
+	_string->size = _string->len + 1;
+	_string->data = string_buf_realloc(_string->data, _string->size);
 	if (!_string->data) return false;
 	return true;
 }
 
-const bool String_clear(String_t* restrict _string)
+CT_API const bool String_clear(String_t* restrict _string)
 {
-	if (!_string) return false;
+	CT_INSTRUMENT_FN("String.clear");
+	if (!String_make_unique(_string)) return false;
 	_string->data[0] = '\0';
-	_string->len = 1;
+	_string->len = 0;
 	return true;
 }
 
-const bool String_free(String_t* restrict _string)
+CT_API const bool String_free(String_t* restrict _string)
 {
+	CT_INSTRUMENT_FN("String.free");
 	if (!_string) return false;
-	free(_string->data);
+	string_buf_release(_string->data);
 	_string->data = NULL;
-	free(_string);
+	CT_FREE(_string);
 	_string = NULL;
 	return true;
 }
 
-const bool String_free_owned(String_t* restrict _string)
+CT_API const bool String_free_owned(String_t* restrict _string)
 {
+	CT_INSTRUMENT_FN("String.free_owned");
 	if (!_string) return false;
-	free(_string->data);
+	string_buf_release(_string->data);
 	_string->data = NULL;
 	_string = NULL;
 	return true;
 }
 
-Optional(String_t) String_owned_from(const char* restrict _str)
+CT_API Optional(String_t) String_owned_from_n(const char* restrict _str, const register u64 _str_len)
+/*
+ | Builds an owned String_t from the first _str_len bytes of _str, for callers that know the length
+*/
 {
+	CT_INSTRUMENT_FN("String.owned_from_n");
 	if (!_str) return None(String_t);
 
-	const u64 _str_len = strlen(_str);
 	String_t string;
 	string.len = _str_len;
 	string.size = mem_round(_str_len, MEM_ALIGNMENT);
 
-	string.data = (char*)malloc(string.size);
-	strncpy(string.data, _str, _str_len);
+	string.data = string_buf_alloc(string.size);
+	if (!string.data) return None(String_t);
+	memcpy(string.data, _str, _str_len);
+	string.data[_str_len] = '\0';
+	CT_COPIED(_str_len);
 
 	return Some(String_t, string);
 }
 
-String_t* String_from(const char* restrict _str)
+CT_API Optional(String_t) String_owned_from(const char* restrict _str)
+{
+	CT_INSTRUMENT_FN("String.owned_from");
+	if (!_str) return None(String_t);
+	return String_owned_from_n(_str, strlen(_str));
+}
+
+CT_API String_t* String_from_n(const char* restrict _str, const register u64 _str_len)
 {
+	CT_INSTRUMENT_FN("String.from_n");
 	if (!_str) return NULL; 
-	const u64 _str_len = strlen(_str);
 
-	String_t* string = (String_t*)malloc(sizeof(String_t));
+	String_t* string = (String_t*)CT_MALLOC(sizeof(String_t));
+	if (!string) return NULL;
 
 	string->len = _str_len;
 	string->size = mem_round(_str_len, MEM_ALIGNMENT);
 	
-	string->data = (char*)malloc(string->size);
-	strncpy(string->data, _str, _str_len);
+	string->data = string_buf_alloc(string->size);
+	if (!string->data) {
+		CT_FREE(string);
+		return NULL;
+	}
+	memcpy(string->data, _str, _str_len);
+	string->data[_str_len] = '\0';
+	CT_COPIED(_str_len);
 	
 	return string;
 }
 
-String_t* String_from_file(FILE* restrict _f_ptr)
+CT_API String_t* String_from(const char* restrict _str)
+{
+	CT_INSTRUMENT_FN("String.from");
+	if (!_str) return NULL; 
+	return String_from_n(_str, strlen(_str));
+}
+
+CT_API Optional(String_t) String_share(const String_t* restrict _string)
+/*
+ | Another handle on the same bytes, release it with String.free_owned
+ | Without CT_STRING_COW this is a deep copy
+*/
+{
+	CT_INSTRUMENT_FN("String.share");
+	if (!_string || !_string->data) return None(String_t);
+#ifdef CT_STRING_COW
+	atomic_fetch_add_explicit(&string_buf(_string->data)->refs, 1, memory_order_relaxed);
+	return Some(String_t, *_string);
+#else
+	return String_owned_from_n(_string->data, _string->len);
+#endif
+}
+
+/*
+ | Literal constructors, the length comes from sizeof so no strlen runs, and the "" _s "" pasting
+ | rejects anything that is not a string literal at compile time
+ | String_lit is a read-only view over the literal itself: never mutate, resize, share or free it
+*/
+#define String_lit(_s) \
+	((String_t){ .data = "" _s "", .size = sizeof(_s), .len = sizeof(_s) - 1 })
+// End String_lit
+
+#define String_owned_from_lit(_s) String_owned_from_n(("" _s ""), sizeof(_s) - 1)
+#define String_from_lit(_s) String_from_n(("" _s ""), sizeof(_s) - 1)
+
+CT_API String_t* String_from_file(FILE* restrict _f_ptr)
 {
+	CT_INSTRUMENT_FN("String.from_file");
 	if (!_f_ptr) return NULL;
 	
 	fseek(_f_ptr, 0L, SEEK_END);
 	const u64 _f_size = ftell(_f_ptr);
 	rewind(_f_ptr);
 
-	String_t* string = (String_t*)malloc(sizeof(String_t));
-	if (!String_resize(string, _f_size)) return NULL;
+	String_t* string = (String_t*)CT_CALLOC(1, sizeof(String_t));
+	if (!string) return NULL;
+	if (!String_resize(string, _f_size + 1)) {
+		CT_FREE(string);
+		return NULL;
+	}
 	string->len = _f_size;
 
 	fread(string->data, string->len, 1, _f_ptr);
+	CT_COPIED(string->len);
+	string->data[string->len] = '\0';
 	fclose(_f_ptr);
 
 	return string;
 }
 
-Optional(String_t) String_owned_slice_from(const char* restrict _str, const register u64 _start, const register u64 _end)
+CT_API Optional(String_t) String_owned_slice_from(const char* restrict _str, const register u64 _start, const register u64 _end)
+/*
+ | Builds an owned String_t from the bytes of _str in [_start, _end)
+ | Only the first _end bytes are checked for a NUL, the rest of _str is never read
+*/
 {
-	const u64 _str_len = strlen(_str);
-	
-	if (!_str || _end > _start || _start < 0 || _end > _str_len) return None(String_t);
-	
-	String_t string;
-	string.len = _str_len;
-	string.size = mem_round(_end-_start, MEM_ALIGNMENT);
-
-	string.data = (char*)malloc(string.size);
-	strncpy(string.data+_start, _str, _end+1);
-
-	return Some(String_t, string);
+	CT_INSTRUMENT_FN("String.owned_slice_from");
+	if (!_str || _start > _end || memchr(_str, '\0', _end)) return None(String_t);
+	return String_owned_from_n(_str + _start, _end - _start);
 }
 
-String_t* String_slice_from(const char* restrict _str, const register u64 _start, const register u64 _end)
+CT_API String_t* String_slice_from(const char* restrict _str, const register u64 _start, const register u64 _end)
+/*
+ | Heap allocated String_t holding the bytes of _str in [_start, _end)
+*/
 {
-	const u64 _str_len = strlen(_str);
-	
-	if (!_str || _end > _start || _start < 0 || _end > _str_len) return NULL;
-	
-	String_t* string = (String_t*)malloc(sizeof(String_t));
-	string->len = _str_len;
-	string->size = mem_round(_end-_start, MEM_ALIGNMENT);
-
-	string->data = (char*)malloc(string->size);
-	strncpy(string->data+_start, _str, _end+1);
-
-	return string;
+	CT_INSTRUMENT_FN("String.slice_from");
+	if (!_str || _start > _end || memchr(_str, '\0', _end)) return NULL;
+	return String_from_n(_str + _start, _end - _start);
 }
 
-u64 String_size(const String_t* _string)
+CT_API u64 String_size(const String_t* _string)
 {
+	CT_INSTRUMENT_FN("String.size");
 	return _string->size;
 }
 
-u64 String_len(const String_t* _string)
+CT_API u64 String_len(const String_t* _string)
 {
+	CT_INSTRUMENT_FN("String.len");
 	return _string->len;
 }
 
-char* String_cstr(const String_t* _string)
+CT_API char* String_cstr(const String_t* _string)
 {
+	CT_INSTRUMENT_FN("String.cstr");
 	return _string->data;
 }
 
-char* String_owned_cstr(const String_t* _string)
+CT_API char* String_owned_cstr(const String_t* _string)
 {
-	char* buf = (char*)malloc(_string->len);
-	strncpy(buf, _string->data, _string->len);
+	CT_INSTRUMENT_FN("String.owned_cstr");
+	if (!_string || !_string->data) return NULL;
+	char* buf = (char*)CT_MALLOC(_string->len + 1);
+	if (!buf) return NULL;
+	memcpy(buf, _string->data, _string->len);
+	buf[_string->len] = '\0';
+	CT_COPIED(_string->len);
 	return buf;
 }
 
-const bool String_append(String_t* _string, const char* _str)
+CT_API const bool String_append_n(String_t* _string, const char* _str, const register u64 _str_len)
+/*
+ | Appends the first _str_len bytes of _str, for callers that already know the length
+*/
 {
-	if (!_string || _str) return false;
-	const u64 _str_len = strlen(_str);
-	if (_str_len+_string->len > _string->size)
-		String_resize(_string, _str_len);
-	
+	CT_INSTRUMENT_FN("String.append_n");
+	if (!_string || !_str) return false;
+	// append_str(s, s) and sources inside s: keep the offset, the buffer may move below
+	const u64 offset = string_alias_offset(_string, _str);
+	const bool aliased = offset < _string->size;
+	if (!String_make_unique(_string)) return false;
+	if (_string->len + _str_len >= _string->size)
+		if (!String_resize(_string, _str_len)) return false;
+	if (aliased) _str = _string->data + offset;
+
+	memcpy(_string->data + _string->len, _str, _str_len);
+	CT_COPIED(_str_len);
 	_string->len += _str_len;
-	strncat(_string->data, _str, _str_len);
+	_string->data[_string->len] = '\0';
 
 	return true;
 }
 
-const bool String_append_str(String_t* _string, const String_t* _str)
+CT_API const bool String_append(String_t* _string, const char* _str)
+{
+	CT_INSTRUMENT_FN("String.append");
+	if (!_string || !_str) return false;
+	return String_append_n(_string, _str, strlen(_str));
+}
+
+CT_API const bool String_append_str(String_t* _string, const String_t* _str)
 {
-	return String_append(_string, _str->data);
+	CT_INSTRUMENT_FN("String.append_str");
+	if (!_str) return false;
+	return String_append_n(_string, _str->data, _str->len);
 }
 
-const bool String_append_file(String_t* _string, FILE* restrict _f_ptr)
+CT_API const bool String_append_file(String_t* _string, FILE* restrict _f_ptr)
 {
+	CT_INSTRUMENT_FN("String.append_file");
 	if (!_f_ptr || !_string) return false;
+	if (!String_make_unique(_string)) return false;
 	
 	fseek(_f_ptr, 0L, SEEK_END);
 	const u64 _f_size = ftell(_f_ptr);
@@ -244,167 +529,450 @@ const bool String_append_file(String_t* _string, FILE* restrict _f_ptr)
 	if ((_string->len + _f_size) >= _string->size) 
 		if (!String_resize(_string, _f_size))
 			return false;
-	_string->len += _f_size;
 
-	fread(_string->data, _string->len, 1, _f_ptr);
+	const u64 read = fread(_string->data + _string->len, 1, _f_size, _f_ptr);
+	CT_COPIED(read);
+	_string->len += read;
+	_string->data[_string->len] = '\0';
 	fclose(_f_ptr);
 
 	return true;
 }
 
-char* String_at(const String_t* _string, const register u64 _idx)
+CT_API char* String_at(const String_t* _string, const register u64 _idx)
 {
-	return (_idx > _string->len || !_string) ? &_string->data[_idx] : NULL;
+	CT_INSTRUMENT_FN("String.at");
+	return (_string && _idx < _string->len) ? &_string->data[_idx] : NULL;
 }
 
-char* String_begin(const String_t* _string) 
+CT_API char* String_begin(const String_t* _string) 
 {
-	return (!_string) ? &_string->data[0] : NULL;
+	CT_INSTRUMENT_FN("String.begin");
+	return (_string) ? &_string->data[0] : NULL;
 }
 
-char* String_end(const String_t* _string) 
+CT_API char* String_end(const String_t* _string) 
 {
-	return (!_string) ? &_string->data[_string->len] : NULL;
+	CT_INSTRUMENT_FN("String.end");
+	return (_string) ? &_string->data[_string->len] : NULL;
 }
 
-const bool String_slice(String_t* _string, const register u64 _start, const register u64 _end)
+CT_API const bool String_slice(String_t* _string, const register u64 _start, const register u64 _end)
+/*
+ | Keeps only the bytes in [_start, _end)
+*/
 {
-	if (_end > _string->len || _end+_start > _string->len || _start < 0 || !_string) return false;
-	for (u16 idx = 0; idx <= _end; ++idx)
-		_string->data[idx] = _string->data[idx+_start];
-	_string->data[_end+1] = '\0';
+	CT_INSTRUMENT_FN("String.slice");
+	if (!_string || _start > _end || _end > _string->len) return false;
+	if (!String_make_unique(_string)) return false;
+	memmove(_string->data, _string->data + _start, _end - _start);
+	CT_COPIED(_end - _start);
 
 	_string->len = (_end - _start);
+	_string->data[_string->len] = '\0';
 
 	return true;
 }
 
-const bool String_remove(String_t* _string, const char* _str) 
+static u64 string_count(const char* restrict _haystack, const u64 _haystack_len, const char* restrict _needle, const u64 _needle_len)
 /*
- | Removes all instances of a substr
- | Credit: chqrlie
- | Source: https://stackoverflow.com/questions/47116974/remove-a-substring-from-a-string-in-c
+ | Number of non-overlapping matches of _needle, scanning left to right
 */
 {
-	if (!_string || !_str) return false;
-	const u64 _str_len = strlen(_str);
-	bool match = false;
-	
-	char *p, *q, *r;
-	if (*_str && (q = r = strstr(_string->data, _str))) {
-		while ( (r = strstr(p = r + _str_len, _str)) != NULL ) {
-			while ( p < r ) *q++ = *p++;
+	u64 count = 0;
+	const char* curr = _haystack;
+	const char* end = _haystack + _haystack_len;
+	while ( (curr = string_memfind(curr, end - curr, _needle, _needle_len)) != NULL ) {
+		++count;
+		curr += _needle_len;
+	}
+	return count;
+}
+
+CT_API const bool String_replace_all_n(String_t* _string, const char* _needle, const register u64 _needle_len, const char* _replacement, const register u64 _replacement_len)
+/*
+ | Replaces every non-overlapping _needle with _replacement in O(n) with at most one allocation
+ | Shrinking or equal length replacements compact in place in a single pass, growing ones first
+ | count the matches so the final length is known, then copy once into an exactly sized buffer
+ | Both arguments are byte ranges, so either may contain NULs
+ | Returns false if there was nothing to replace
+*/
+{
+	CT_INSTRUMENT_FN("String.replace_all_n");
+	if (!_string || !_string->data || !_needle || !_replacement || _needle_len == 0) return false;
+
+	if (_needle_len == 1 && _replacement_len <= 1) {
+		// single byte rewrites are dense enough that a plain loop beats a search call per match
+		const char needle = _needle[0];
+		const char replacement = _replacement_len ? _replacement[0] : 0;
+		const char* first = (const char*)memchr(_string->data, needle, _string->len);
+		if (!first) return false;
+
+		// only unshare once there is something to rewrite, bytes before the first match stay put
+		const u64 start = first - _string->data;
+		if (!String_make_unique(_string)) return false;
+		char* data = _string->data;
+		u64 kept = start;
+		u64 count = 0;
+		for ( u64 idx = start; idx < _string->len; ++idx ) {
+			const char curr = data[idx];
+			data[kept] = (curr == needle) ? replacement : curr;
+			kept += (curr != needle) | _replacement_len;
+			count += (curr == needle);
+		}
+		CT_COPIED(kept - start);
+
+		_string->len = kept;
+		if (kept < _string->size) data[kept] = '\0';
+		return count != 0;
+	}
+
+	if (_needle_len == 1) {
+		const char needle = _needle[0];
+		const char* data = _string->data;
+		u64 count = 0;
+		for ( u64 idx = 0; idx < _string->len; ++idx ) count += (data[idx] == needle);
+		if (count == 0) return false;
+
+		const u64 new_len = _string->len + count * (_replacement_len - 1);
+		const u64 new_size = mem_round(new_len, MEM_ALIGNMENT);
+		char* out = string_buf_alloc(new_size);
+		if (!out) return false;
+
+		char* dst = out;
+		for ( u64 idx = 0; idx < _string->len; ++idx ) {
+			if (data[idx] == needle) {
+				memcpy(dst, _replacement, _replacement_len);
+				dst += _replacement_len;
+			}
+			else *dst++ = data[idx];
+		}
+		out[new_len] = '\0';
+		CT_COPIED(new_len);
+
+		string_buf_release(_string->data);
+		_string->data = out;
+		_string->size = new_size;
+		_string->len = new_len;
+		return true;
+	}
+
+	const char* src = _string->data;
+	const char* end = _string->data + _string->len;
+	const char* match = string_memfind(src, end - src, _needle, _needle_len);
+	if (!match) return false;
+
+	u64 new_len;
+	if (_replacement_len <= _needle_len) {
+		// the write head never passes the read head, so the bytes still to be searched stay
+		// intact and the new length falls out of the single compacting pass
+		const u64 first = match - _string->data;
+
+		// a needle or replacement taken from the string itself would be overwritten by the
+		// compaction and then searched for again, work from a copy of both instead
+		char local[STRING_PATTERN_BUF];
+		char* pattern = NULL;
+		if (string_aliases(_string, _needle) || string_aliases(_string, _replacement)) {
+			const u64 pattern_len = _needle_len + _replacement_len;
+			pattern = (pattern_len <= STRING_PATTERN_BUF) ? local : (char*)CT_MALLOC(pattern_len);
+			if (!pattern) return false;
+			memcpy(pattern, _needle, _needle_len);
+			memcpy(pattern + _needle_len, _replacement, _replacement_len);
+			CT_COPIED(pattern_len);
+			_needle = pattern;
+			_replacement = pattern + _needle_len;
+		}
+
+		if (!String_make_unique(_string)) {
+			if (pattern != local) CT_FREE(pattern);
+			return false;
 		}
-		match = true;
-		while ( (*q++ = *p++) != '\0')
-			continue;
+		src = _string->data + first + _needle_len;
+		end = _string->data + _string->len;
+
+		char* dst = _string->data + first;
+		memcpy(dst, _replacement, _replacement_len);
+		dst += _replacement_len;
+		while ( (match = string_memfind(src, end - src, _needle, _needle_len)) != NULL ) {
+			if (dst != src) memmove(dst, src, match - src);
+			dst += match - src;
+			memcpy(dst, _replacement, _replacement_len);
+			dst += _replacement_len;
+			src = match + _needle_len;
+		}
+		memmove(dst, src, end - src);
+		dst += end - src;
+
+		new_len = dst - _string->data;
+		CT_COPIED(new_len - first);
+		if (pattern != local) CT_FREE(pattern);
+	}
+	else {
+		// growing needs the final length up front, count once and write into one exact buffer
+		const u64 count = 1 + string_count(match + _needle_len, end - (match + _needle_len), _needle, _needle_len);
+		new_len = _string->len + count * (_replacement_len - _needle_len);
+
+		const u64 new_size = mem_round(new_len, MEM_ALIGNMENT);
+		char* out = string_buf_alloc(new_size);
+		if (!out) return false;
+
+		char* dst = out;
+		do {
+			memcpy(dst, src, match - src);
+			dst += match - src;
+			memcpy(dst, _replacement, _replacement_len);
+			dst += _replacement_len;
+			src = match + _needle_len;
+		} while ( (match = string_memfind(src, end - src, _needle, _needle_len)) != NULL );
+		memcpy(dst, src, end - src);
+		CT_COPIED(new_len);
+
+		string_buf_release(_string->data);
+		_string->data = out;
+		_string->size = new_size;
 	}
-	_string->len -= _str_len;
 
-	return match;
+	_string->len = new_len;
+	if (new_len < _string->size) _string->data[new_len] = '\0';
+	return true;
 }
 
-const bool String_remove_slice(String_t* _string, const register u64 _start, const register u64 _end)
+CT_API const bool String_replace_all(String_t* _string, const char* _needle, const char* _replacement)
 {
-	if ((_start + _end) >= _string->len || _start < 0 || _end >= _string->len || !_string) return false;
-	if (!strncpy(&_string->data[_start], &_string->data[_end] + 1, _string->len)) return false;
+	CT_INSTRUMENT_FN("String.replace_all");
+	if (!_needle || !_replacement) return false;
+	return String_replace_all_n(_string, _needle, strlen(_needle), _replacement, strlen(_replacement));
+}
+
+CT_API const bool String_remove_all(String_t* _string, const char* _str)
+/*
+ | Removes every non-overlapping instance of _str in a single compacting pass
+*/
+{
+	CT_INSTRUMENT_FN("String.remove_all");
+	return String_replace_all(_string, _str, "");
+}
+
+CT_API const bool String_remove(String_t* _string, const char* _str) 
+/*
+ | Removes all instances of a substr
+*/
+{
+	CT_INSTRUMENT_FN("String.remove");
+	return String_remove_all(_string, _str);
+}
+
+CT_API const bool String_remove_slice(String_t* _string, const register u64 _start, const register u64 _end)
+/*
+ | Removes the bytes in [_start, _end)
+*/
+{
+	CT_INSTRUMENT_FN("String.remove_slice");
+	if (!_string || _start > _end || _end > _string->len) return false;
+	if (!String_make_unique(_string)) return false;
+	// the tail, NUL included, slides down over [_start, _end)
+	memmove(&_string->data[_start], &_string->data[_end], (_string->len - _end) + 1);
+	CT_COPIED((_string->len - _end) + 1);
 
 	_string->len -= (_end - _start);
-	return false;
+	return true;
 }
 
-const bool String_strip(String_t* _string, const char* _delims)
+CT_API const bool String_strip(String_t* _string, const char* _delims)
 {
+	CT_INSTRUMENT_FN("String.strip");
 	if (!_string || !_delims) return false;
-	DELIM_BUF[1] = '\0';
-	for ( ; *_delims != '\0'; _delims++ ) {
-		DELIM_BUF[0] = *_delims;
-		if (!String_remove(_string, DELIM_BUF)) return false;
+	if (!String_make_unique(_string)) return false;
+
+	// one pass over the bytes against a 256 bit set of delimiters, rather than one pass per delimiter
+	u64 set[4] = { 0 };
+	for ( ; *_delims != '\0'; _delims++ ) set[(u8)*_delims >> 6] |= 1UL << ((u8)*_delims & 63);
+
+	char* data = _string->data;
+	const u64 len = _string->len;
+	u64 kept = 0;
+	for ( u64 idx = 0; idx < len; ++idx ) {
+		const u8 curr = (u8)data[idx];
+		data[kept] = (char)curr;
+		kept += !((set[curr >> 6] >> (curr & 63)) & 1);
 	}
-	
-	_string->len = strlen(_string->data);
+	CT_COPIED(kept);
 
+	_string->len = kept;
+	if (kept < _string->size) data[kept] = '\0';
 	return true;
 }
 
-const bool String_insert(String_t* _string, const char* _str, const register u64 _idx)
+CT_API const bool String_insert_n(String_t* _string, const char* _str, const register u64 _str_len, const register u64 _idx)
+/*
+ | Inserts the first _str_len bytes of _str before _idx
+*/
 {
-	if (_idx > _string->len || !_string || !_str) return false;
-	const u64 _str_len = strlen(_str);
+	CT_INSTRUMENT_FN("String.insert_n");
+	if (!_string || !_str || _idx > _string->len) return false;
+	// insert_str(s, s, i) and sources inside s: keep the offset, the buffer may move below
+	const u64 offset = string_alias_offset(_string, _str);
+	const bool aliased = offset < _string->size;
+	if (!String_make_unique(_string)) return false;
 	const u64 _new_len = _string->len + _str_len;
 	
-	if ((_string->len + _str_len) > _string->size) String_resize(_string, _str_len);
-	char* tmp = (char*)malloc(_string->len);
-	
-	strncpy(tmp, _string->data+_idx, (_string->len-_idx));
-	strncpy(_string->data+_idx, _str, _str_len);
-	strncpy(_string->data+(_idx+_str_len), tmp, _new_len);
+	if (_new_len >= _string->size && !String_resize(_string, _str_len+1)) return false;
+
+	// shift the tail (and its NUL) up in place instead of bouncing it through a temporary
+	memmove(_string->data+(_idx+_str_len), _string->data+_idx, (_string->len-_idx)+1);
+	if (!aliased) memcpy(_string->data+_idx, _str, _str_len);
+	else {
+		// source bytes before _idx stayed put, the ones from _idx on now sit _str_len higher
+		const u64 head = (offset < _idx) ? ((_idx - offset < _str_len) ? _idx - offset : _str_len) : 0;
+		memcpy(_string->data+_idx, _string->data+offset, head);
+		memcpy(_string->data+_idx+head, _string->data+(offset+head+_str_len), _str_len - head);
+	}
+	CT_COPIED((_string->len-_idx)+1+_str_len);
 
 	_string->len = _new_len;
-	
-	free(tmp);
 	return true;
 }
 
-const bool String_insert_str(String_t* _string, const String_t* _str, const register u64 _idx)
+CT_API const bool String_insert(String_t* _string, const char* _str, const register u64 _idx)
 {
-	return String_insert(_string, _str->data, _idx);
+	CT_INSTRUMENT_FN("String.insert");
+	if (!_str) return false;
+	return String_insert_n(_string, _str, strlen(_str), _idx);
 }
 
-const bool String_replace(String_t* _string, const char _c, const register u64 _idx)
+CT_API const bool String_insert_str(String_t* _string, const String_t* _str, const register u64 _idx)
 {
-	if (!_string || _idx > _string->len) return false;
+	CT_INSTRUMENT_FN("String.insert_str");
+	if (!_str) return false;
+	return String_insert_n(_string, _str->data, _str->len, _idx);
+}
+
+CT_API const bool String_replace(String_t* _string, const char _c, const register u64 _idx)
+{
+	CT_INSTRUMENT_FN("String.replace");
+	if (!_string || _idx >= _string->len) return false;
+	if (!String_make_unique(_string)) return false;
 	_string->data[_idx] = _c;
 	return true;
 }
 
-const bool String_rev(String_t* _string)
+CT_API const bool String_rev(String_t* _string)
 {
-	char* buf = (char*)malloc(_string->len);
-	for ( u64 idx = 0; idx < _string->len; ++idx )
-		buf[idx] = _string->data[_string->len-idx-1];
-	
-	strncpy(_string->data, buf, _string->len);
-
-	free(buf);
+	CT_INSTRUMENT_FN("String.rev");
+	if (!_string) return false;
+	if (!String_make_unique(_string)) return false;
+	if (_string->len < 2) return true;
+
+	// swap from both ends in place, no scratch buffer
+	char* lo = _string->data;
+	char* hi = _string->data + _string->len - 1;
+	for ( ; lo < hi; ++lo, --hi ) {
+		const char tmp = *lo;
+		*lo = *hi;
+		*hi = tmp;
+	}
+	CT_COPIED(_string->len);
 	return true;
 }
 
-const bool String_toupper(String_t* _string)
+CT_API const bool String_toupper(String_t* _string)
 {
+	CT_INSTRUMENT_FN("String.toupper");
 	if (!_string) return false;
-	char curr;
-	for ( u64 idx = 0; (curr = _string->data[idx]) != '\0'; ++idx )
-		_string->data[idx] = ( curr >= 97 && curr <= 122 ) ? curr-32 : curr;
+	if (!String_make_unique(_string)) return false;
+	char* data = _string->data;
+	const u64 len = _string->len; // hoisted, stores through char* would otherwise reload it
+	for ( u64 idx = 0; idx < len; ++idx ) {
+		const char curr = data[idx];
+		data[idx] = ( curr >= 97 && curr <= 122 ) ? curr-32 : curr;
+	}
 	return true;
 }
 
-const bool String_tolower(String_t* _string)
+CT_API const bool String_tolower(String_t* _string)
 {
-	char curr;
-	for ( u64 idx = 0; (curr = _string->data[idx]) != '\0'; ++idx )
-		_string->data[idx] = ( curr >= 65 && curr <= 90 ) ? curr+32 : curr;
+	CT_INSTRUMENT_FN("String.tolower");
+	if (!_string) return false;
+	if (!String_make_unique(_string)) return false;
+	char* data = _string->data;
+	const u64 len = _string->len; // hoisted, stores through char* would otherwise reload it
+	for ( u64 idx = 0; idx < len; ++idx ) {
+		const char curr = data[idx];
+		data[idx] = ( curr >= 65 && curr <= 90 ) ? curr+32 : curr;
+	}
 	return true;
 }
 
-Optional(u64) String_find(const String_t* _string, const char* _str)
+CT_API Optional(u64) String_find_n(const String_t* _string, const char* _str, const register u64 _str_len)
+/*
+ | Byte offset of the first occurrence of the _str_len bytes at _str
+*/
 {
-	if (!_string || !_str) return None(u64);
-	char* curr = strstr(_string->data, _str);
-	if (!curr) return None(u64);
+	CT_INSTRUMENT_FN("String.find_n");
+	if (!_string || !_str || !_string->data) return None(u64);
+	const char* match = string_memfind(_string->data, _string->len, _str, _str_len);
+	if (!match) return None(u64);
+
+	return Some(u64, (u64)(match - _string->data));
+}
+
+CT_API Optional(u64) String_find(const String_t* _string, const char* _str)
+{
+	CT_INSTRUMENT_FN("String.find");
+	if (!_str) return None(u64);
+	return String_find_n(_string, _str, strlen(_str));
+}
 
-	return Some(u64, (_string->len - strlen(curr)));
+CT_API i32 String_cmp(const String_t* _a, const String_t* _b)
+/*
+ | Lexicographic byte order, negative / zero / positive like memcmp, a proper prefix sorts first
+*/
+{
+	CT_INSTRUMENT_FN("String.cmp");
+	const u64 min_len = (_a->len < _b->len) ? _a->len : _b->len;
+	if (min_len >= 8) {
+		// most pairs differ in their first 8 bytes, settle those with one big-endian compare
+		u64 a_head;
+		u64 b_head;
+		memcpy(&a_head, _a->data, 8);
+		memcpy(&b_head, _b->data, 8);
+		if (a_head != b_head) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			a_head = __builtin_bswap64(a_head);
+			b_head = __builtin_bswap64(b_head);
+#endif
+			return (a_head > b_head) ? 1 : -1;
+		}
+	}
+	const i32 order = (_a->data == _b->data) ? 0 : memcmp(_a->data, _b->data, min_len);
+	if (order) return order;
+	return (_a->len > _b->len) - (_a->len < _b->len);
+}
+
+CT_API const bool String_eq(const String_t* _a, const String_t* _b)
+/*
+ | Lengths are compared first so most unequal pairs never touch the bytes, shared buffers
+ | (CT_STRING_COW) compare equal without a scan
+*/
+{
+	CT_INSTRUMENT_FN("String.eq");
+	if (_a->len != _b->len) return false;
+	return _a->data == _b->data || memcmp(_a->data, _b->data, _a->len) == 0;
 }
 
-void String_dump(const String_t* _string)
+CT_API void String_dump(const String_t* _string)
 {
-	printf("String: %s\nLength: %zu\nMem-Size: %zu\n", _string->data, _string->len, _string->size);
+	fputs("String: ", stdout);
+	fwrite(_string->data, 1, _string->len, stdout);
+	printf("\nLength: %zu\nMem-Size: %zu\n", _string->len, _string->size);
 	return;
 }
 
 const static struct String_funcs String = {
 	String_owned_from,
+	String_owned_from_n,
 	String_from,
+	String_from_n,
 	String_from_file,
 	String_owned_slice_from,
 	String_slice_from,
@@ -413,6 +981,7 @@ const static struct String_funcs String = {
 	String_cstr,
 	String_owned_cstr,
 	String_append,
+	String_append_n,
 	String_append_str,
 	String_append_file,
 	String_at,
@@ -420,20 +989,30 @@ const static struct String_funcs String = {
 	String_end,
 	String_slice,
 	String_remove,
+	String_remove_all,
 	String_remove_slice,
 	String_strip,
 	String_insert,
+	String_insert_n,
 	String_insert_str,
 	String_replace,
+	String_replace_all,
+	String_replace_all_n,
 	String_rev,
 	String_toupper,
 	String_tolower,
 	String_find,
+	String_find_n,
+	String_cmp,
+	String_eq,
 	String_resize,
 	String_shrink,
 	String_clear,
 	String_free,
 	String_free_owned,
+	String_share,
+	String_refs,
+	String_make_unique,
 };
 
 #endif // End _CT_STL_STRING_H
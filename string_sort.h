@@ -0,0 +1,261 @@
+#ifndef _CT_STL_STRING_SORT_H
+#define _CT_STL_STRING_SORT_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "string.h"
+#include "stack_string.h"
+#include "types.h"
+
+/*
+ | In place lexicographic sort for arrays of String_t and SS_t, same order as String.cmp / SS.cmp
+ | Multikey quicksort over cached prefixes: each element gets an 8 byte big-endian prefix at the
+ | current depth packed into a 16 byte entry next to its index, the entries are 3-way partitioned
+ | on that prefix without touching the strings, and only runs that tie on all 8 bytes reload
+ | the next 8 bytes of their strings, so most comparisons are one integer compare on contiguous memory
+ | Elements are moved once at the end through a scratch copy of the array
+*/
+
+#ifndef STRING_SORT_INSERTION
+#define STRING_SORT_INSERTION 16
+#endif
+
+// shared prefix length in bytes past which a run is finished with a plain memcmp sort
+#ifndef STRING_SORT_MAX_DEPTH
+#define STRING_SORT_MAX_DEPTH 1024
+#endif
+
+typedef struct String_sort_view {
+	const char* data;
+	u64 len;
+} String_sort_view;
+
+typedef struct String_sort_entry {
+	u64 key;	// next 8 bytes at the current depth, big-endian and zero padded
+	u32 tail;	// bytes left at the current depth capped at 9, orders a string before its zero padded extensions
+	u32 idx;
+} String_sort_entry;
+
+struct StringSort_funcs {
+	const bool	(*string)(String_t*, const u64);
+	const bool	(*ss)(SS_t*, const u64);
+};
+
+static inline void StringSort_load_key(String_sort_entry* restrict _entry, const String_sort_view* restrict _views, const u64 _depth)
+{
+	const String_sort_view* view = &_views[_entry->idx];
+	const u64 left = view->len - _depth;
+	u64 key = 0;
+	if (left >= 8) memcpy(&key, view->data + _depth, 8);
+	else memcpy(&key, view->data + _depth, left);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	key = __builtin_bswap64(key);
+#endif
+	_entry->key = key;
+	_entry->tail = (left > 8) ? 9 : (u32)left;
+}
+
+static inline const bool StringSort_less(const String_sort_entry* _a, const String_sort_entry* _b)
+{
+	return _a->key < _b->key || (_a->key == _b->key && _a->tail < _b->tail);
+}
+
+static inline void StringSort_swap(String_sort_entry* _a, String_sort_entry* _b)
+{
+	const String_sort_entry tmp = *_a;
+	*_a = *_b;
+	*_b = tmp;
+}
+
+static void StringSort_insertion(String_sort_entry* _entries, const u64 _n)
+{
+	for ( u64 idx = 1; idx < _n; ++idx ) {
+		const String_sort_entry curr = _entries[idx];
+		u64 pos = idx;
+		for ( ; pos > 0 && StringSort_less(&curr, &_entries[pos-1]); --pos ) _entries[pos] = _entries[pos-1];
+		_entries[pos] = curr;
+	}
+}
+
+static void StringSort_keys(String_sort_entry* _entries, u64 _n)
+/*
+ | Sorts _entries on (key, tail), recursing into the smaller side and looping on the larger
+*/
+{
+	while ( _n > STRING_SORT_INSERTION ) {
+		// median of three as the pivot, kept by value since the partition moves entries around
+		String_sort_entry* lo = &_entries[0];
+		String_sort_entry* mid = &_entries[_n / 2];
+		String_sort_entry* hi = &_entries[_n - 1];
+		if (StringSort_less(mid, lo)) StringSort_swap(mid, lo);
+		if (StringSort_less(hi, mid)) StringSort_swap(hi, mid);
+		if (StringSort_less(mid, lo)) StringSort_swap(mid, lo);
+		const String_sort_entry pivot = *mid;
+
+		// Dijkstra 3-way partition: [0, lt) < pivot, [lt, idx) == pivot, (gt, _n) > pivot
+		u64 lt = 0;
+		u64 gt = _n - 1;
+		u64 idx = 0;
+		while ( idx <= gt ) {
+			if (StringSort_less(&_entries[idx], &pivot)) StringSort_swap(&_entries[lt++], &_entries[idx++]);
+			else if (StringSort_less(&pivot, &_entries[idx])) StringSort_swap(&_entries[idx], &_entries[gt--]);
+			else ++idx;
+		}
+
+		const u64 n_less = lt;
+		const u64 n_more = _n - (gt + 1);
+		if (n_less < n_more) {
+			StringSort_keys(_entries, n_less);
+			_entries += gt + 1;
+			_n = n_more;
+		}
+		else {
+			StringSort_keys(_entries + gt + 1, n_more);
+			_n = n_less;
+		}
+	}
+	StringSort_insertion(_entries, _n);
+}
+
+static inline i32 StringSort_view_cmp(const String_sort_view* _a, const String_sort_view* _b, const u64 _depth)
+{
+	const u64 a_len = _a->len - _depth;
+	const u64 b_len = _b->len - _depth;
+	const i32 order = memcmp(_a->data + _depth, _b->data + _depth, (a_len < b_len) ? a_len : b_len);
+	if (order) return order;
+	return (a_len > b_len) - (a_len < b_len);
+}
+
+static void StringSort_sift(String_sort_entry* _entries, u64 _root, const u64 _n, const String_sort_view* restrict _views, const u64 _depth)
+{
+	for ( u64 child = 2 * _root + 1; child < _n; _root = child, child = 2 * _root + 1 ) {
+		if (child + 1 < _n && StringSort_view_cmp(&_views[_entries[child].idx], &_views[_entries[child+1].idx], _depth) < 0) ++child;
+		if (StringSort_view_cmp(&_views[_entries[_root].idx], &_views[_entries[child].idx], _depth) >= 0) return;
+		StringSort_swap(&_entries[_root], &_entries[child]);
+	}
+}
+
+static void StringSort_deep(String_sort_entry* _entries, const u64 _n, const String_sort_view* restrict _views, const u64 _depth)
+/*
+ | Heapsort on memcmp of the bytes past _depth, for runs whose shared prefix outgrew STRING_SORT_MAX_DEPTH
+ | Needs no stack and stays O(n log n) comparisons however long the prefixes get
+*/
+{
+	for ( u64 idx = _n / 2; idx-- > 0; ) StringSort_sift(_entries, idx, _n, _views, _depth);
+	for ( u64 end = _n - 1; end > 0; --end ) {
+		StringSort_swap(&_entries[0], &_entries[end]);
+		StringSort_sift(_entries, 0, end, _views, _depth);
+	}
+}
+
+static void StringSort_range(String_sort_entry* _entries, const u64 _n, const String_sort_view* restrict _views, u64 _depth)
+/*
+ | Orders _entries, whose strings all share their first _depth bytes
+ | Only a run strictly smaller than the range recurses, so the stack grows by at most one frame
+ | per STRING_SORT_MAX_DEPTH / 8 and a range that ties as a whole just moves on to the next 8 bytes
+*/
+{
+	while ( _n > 1 ) {
+		if (_depth >= STRING_SORT_MAX_DEPTH) {
+			StringSort_deep(_entries, _n, _views, _depth);
+			return;
+		}
+		for ( u64 idx = 0; idx < _n; ++idx ) StringSort_load_key(&_entries[idx], _views, _depth);
+		StringSort_keys(_entries, _n);
+
+		// sorted, so the first and last entry tie only when the whole range does
+		if (_entries[0].key == _entries[_n-1].key && _entries[0].tail == _entries[_n-1].tail) {
+			if (_entries[0].tail != 9) return;
+			_depth += 8;
+			continue;
+		}
+
+		// only runs that tie on the key and still have bytes past it need the next 8 bytes
+		for ( u64 start = 0; start < _n; ) {
+			u64 end = start + 1;
+			while ( end < _n && _entries[end].key == _entries[start].key && _entries[end].tail == _entries[start].tail ) ++end;
+			if (_entries[start].tail == 9 && end - start > 1) StringSort_range(_entries + start, end - start, _views, _depth + 8);
+			start = end;
+		}
+		return;
+	}
+}
+
+static const bool StringSort_order(String_sort_entry* _entries, const String_sort_view* restrict _views, const u64 _n)
+{
+	for ( u64 idx = 0; idx < _n; ++idx ) _entries[idx].idx = (u32)idx;
+	StringSort_range(_entries, _n, _views, 0);
+	return true;
+}
+
+CT_API const bool StringSort_string(String_t* _strings, const u64 _n)
+/*
+ | Sorts _n String_t in place, the String_t headers move and the buffers they point to do not
+*/
+{
+	if (!_strings) return false;
+	if (_n < 2) return true;
+	if (_n > 0xFFFFFFFFUL) return false;
+
+	String_sort_view* views = (String_sort_view*)CT_MALLOC(_n * sizeof(String_sort_view));
+	String_sort_entry* entries = (String_sort_entry*)CT_MALLOC(_n * sizeof(String_sort_entry));
+	String_t* scratch = (String_t*)CT_MALLOC(_n * sizeof(String_t));
+	if (!views || !entries || !scratch) {
+		CT_FREE(views);
+		CT_FREE(entries);
+		CT_FREE(scratch);
+		return false;
+	}
+
+	for ( u64 idx = 0; idx < _n; ++idx ) views[idx] = (String_sort_view){ _strings[idx].data, _strings[idx].len };
+	StringSort_order(entries, views, _n);
+
+	for ( u64 idx = 0; idx < _n; ++idx ) scratch[idx] = _strings[entries[idx].idx];
+	memcpy(_strings, scratch, _n * sizeof(String_t));
+
+	CT_FREE(views);
+	CT_FREE(entries);
+	CT_FREE(scratch);
+	return true;
+}
+
+CT_API const bool StringSort_ss(SS_t* _strings, const u64 _n)
+/*
+ | Sorts _n SS_t in place
+*/
+{
+	if (!_strings) return false;
+	if (_n < 2) return true;
+	if (_n > 0xFFFFFFFFUL) return false;
+
+	String_sort_view* views = (String_sort_view*)CT_MALLOC(_n * sizeof(String_sort_view));
+	String_sort_entry* entries = (String_sort_entry*)CT_MALLOC(_n * sizeof(String_sort_entry));
+	SS_t* scratch = (SS_t*)CT_MALLOC(_n * sizeof(SS_t));
+	if (!views || !entries || !scratch) {
+		CT_FREE(views);
+		CT_FREE(entries);
+		CT_FREE(scratch);
+		return false;
+	}
+
+	for ( u64 idx = 0; idx < _n; ++idx ) views[idx] = (String_sort_view){ _strings[idx].data, StackString_len(&_strings[idx]) };
+	StringSort_order(entries, views, _n);
+
+	for ( u64 idx = 0; idx < _n; ++idx ) scratch[idx] = _strings[entries[idx].idx];
+	memcpy(_strings, scratch, _n * sizeof(SS_t));
+
+	CT_FREE(views);
+	CT_FREE(entries);
+	CT_FREE(scratch);
+	return true;
+}
+
+const static struct StringSort_funcs StringSort = {
+	StringSort_string,
+	StringSort_ss,
+};
+
+#endif // End _CT_STL_STRING_SORT_H
@@ -0,0 +1,501 @@
+#ifndef _CT_STL_THREAD_POOL_H
+#define _CT_STL_THREAD_POOL_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "types.h"
+
+#define POOL_MAX_THREADS 64
+#define POOL_DEQUE_SIZE 1024
+#define POOL_SPIN 64
+
+/*
+ | Work function handed to the pool, called with the half open range [begin, end)
+*/
+typedef void (*Pool_fn)(void*, const u64, const u64);
+
+typedef struct TaskGroup_t {
+	atomic_ulong pending;
+} TaskGroup_t;
+
+typedef struct Task_t {
+	Pool_fn fn;
+	void* ctx;
+	u64 begin;
+	u64 end;
+	u64 grain;
+	TaskGroup_t* group;
+	atomic_bool done;
+} Task_t;
+
+/*
+ | Chase-Lev work stealing deque
+ | The owner pushes and takes at the bottom, thieves steal from the top
+ | Source: https://www.di.ens.fr/~zappa/readings/ppopp13.pdf
+*/
+typedef struct Deque_t {
+	_Alignas(CACHE_LINE) atomic_long top;
+	_Alignas(CACHE_LINE) atomic_long bottom;
+	_Alignas(CACHE_LINE) _Atomic(Task_t*) buf[POOL_DEQUE_SIZE];
+} Deque_t;
+
+typedef struct Pool_worker_t {
+	Deque_t deque;
+	struct Pool_t* pool;
+	pthread_t thread;
+	u64 rng;
+} Pool_worker_t;
+
+typedef struct Pool_t {
+	// n_threads workers followed by the slot shared by threads outside the pool
+	Pool_worker_t* workers;
+	u32 n_threads;
+	pthread_mutex_t external;
+
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	atomic_uint sleepers;
+	atomic_bool stop;
+} Pool_t;
+
+struct Pool_funcs {
+	Pool_t*		(*create)(const register u32);
+	Pool_t*		(*global)(void);
+	u32			(*threads)(const Pool_t* restrict);
+	const bool	(*parallel_for)(Pool_t* restrict, const u64, const u64, const u64, Pool_fn, void*);
+	const bool	(*group)(TaskGroup_t* restrict);
+	const bool	(*spawn)(Pool_t* restrict, TaskGroup_t* restrict, Pool_fn, void*, const u64, const u64);
+	const bool	(*wait)(Pool_t* restrict, TaskGroup_t* restrict);
+	const bool	(*destroy)(Pool_t* restrict);
+};
+
+static _Thread_local Pool_worker_t* POOL_SELF = NULL;
+static Task_t POOL_ABORT;
+
+static const bool Deque_push(Deque_t* restrict _deque, Task_t* _task)
+/*
+ | Owner only, returns false when the deque is full so the caller can run _task inline
+*/
+{
+	const long b = atomic_load_explicit(&_deque->bottom, memory_order_relaxed);
+	const long t = atomic_load_explicit(&_deque->top, memory_order_acquire);
+	if (b - t >= POOL_DEQUE_SIZE) return false;
+
+	atomic_store_explicit(&_deque->buf[b & (POOL_DEQUE_SIZE-1)], _task, memory_order_relaxed);
+	atomic_store_explicit(&_deque->bottom, b + 1, memory_order_release);
+
+	return true;
+}
+
+static Task_t* Deque_take(Deque_t* restrict _deque)
+/*
+ | Owner only, pops the most recently pushed task or returns NULL
+*/
+{
+	const long b = atomic_load_explicit(&_deque->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&_deque->bottom, b, memory_order_release);
+	atomic_thread_fence(memory_order_seq_cst);
+	long t = atomic_load_explicit(&_deque->top, memory_order_relaxed);
+
+	if (t > b) {
+		atomic_store_explicit(&_deque->bottom, b + 1, memory_order_release);
+		return NULL;
+	}
+
+	Task_t* task = atomic_load_explicit(&_deque->buf[b & (POOL_DEQUE_SIZE-1)], memory_order_relaxed);
+	if (t == b) {
+		// last task, race the thieves for it
+		if (!atomic_compare_exchange_strong_explicit(&_deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+			task = NULL;
+		atomic_store_explicit(&_deque->bottom, b + 1, memory_order_release);
+	}
+
+	return task;
+}
+
+static Task_t* Deque_steal(Deque_t* restrict _deque)
+/*
+ | Any thread, returns the oldest task, NULL when empty or &POOL_ABORT when another thief won
+*/
+{
+	long t = atomic_load_explicit(&_deque->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	const long b = atomic_load_explicit(&_deque->bottom, memory_order_acquire);
+	if (t >= b) return NULL;
+
+	Task_t* task = atomic_load_explicit(&_deque->buf[t & (POOL_DEQUE_SIZE-1)], memory_order_relaxed);
+	if (!atomic_compare_exchange_strong_explicit(&_deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+		return &POOL_ABORT;
+
+	return task;
+}
+
+static Task_t* Pool_steal(Pool_t* restrict _pool, Pool_worker_t* _self)
+/*
+ | Tries every other deque once starting from a random victim
+*/
+{
+	const u32 n_slots = _pool->n_threads + 1;
+	_self->rng ^= _self->rng << 13;
+	_self->rng ^= _self->rng >> 7;
+	_self->rng ^= _self->rng << 17;
+	const u32 start = _self->rng % n_slots;
+
+	bool contended = true;
+	while ( contended ) {
+		contended = false;
+		for ( u32 idx = 0; idx < n_slots; ++idx ) {
+			Pool_worker_t* victim = &_pool->workers[(start + idx) % n_slots];
+			if (victim == _self) continue;
+
+			Task_t* task = Deque_steal(&victim->deque);
+			if (task == &POOL_ABORT) contended = true;
+			else if (task) return task;
+		}
+	}
+
+	return NULL;
+}
+
+static void Pool_notify(Pool_t* restrict _pool)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&_pool->sleepers, memory_order_relaxed) == 0) return;
+
+	pthread_mutex_lock(&_pool->lock);
+	pthread_cond_signal(&_pool->wake);
+	pthread_mutex_unlock(&_pool->lock);
+}
+
+static void Pool_execute(Pool_t* restrict _pool, Pool_worker_t* _self, Task_t* _task);
+
+static void Pool_range(Pool_t* restrict _pool, Pool_worker_t* _self, Pool_fn _fn, void* _ctx, const u64 _begin, const u64 _end, const u64 _grain)
+/*
+ | Lazy binary splitting, the right half is offered to thieves while this thread works
+ | on the left one, then it is taken back if nobody stole it
+ | The right half lives in this stack frame, which is safe since we join it before returning
+*/
+{
+	if (_end - _begin <= _grain) {
+		_fn(_ctx, _begin, _end);
+		return;
+	}
+
+	// split on a multiple of _grain so every leaf range stays aligned to _begin
+	const u64 n_grains = (_end - _begin + _grain - 1) / _grain;
+	const u64 mid = _begin + (n_grains / 2) * _grain;
+	Task_t right = {
+		.fn = _fn,
+		.ctx = _ctx,
+		.begin = mid,
+		.end = _end,
+		.grain = _grain,
+		.group = NULL,
+	};
+	atomic_init(&right.done, false);
+
+	if (!Deque_push(&_self->deque, &right)) {
+		Pool_range(_pool, _self, _fn, _ctx, _begin, mid, _grain);
+		Pool_range(_pool, _self, _fn, _ctx, mid, _end, _grain);
+		return;
+	}
+	Pool_notify(_pool);
+
+	Pool_range(_pool, _self, _fn, _ctx, _begin, mid, _grain);
+
+	// anything pushed after right has been joined already, so right is on top or stolen
+	Task_t* task = Deque_take(&_self->deque);
+	if (task == &right) {
+		Pool_range(_pool, _self, _fn, _ctx, mid, _end, _grain);
+		return;
+	}
+	if (task) Pool_execute(_pool, _self, task);
+
+	while ( !atomic_load_explicit(&right.done, memory_order_acquire) ) {
+		if ((task = Deque_take(&_self->deque)) || (task = Pool_steal(_pool, _self)))
+			Pool_execute(_pool, _self, task);
+		else
+			sched_yield();
+	}
+}
+
+static void Pool_execute(Pool_t* restrict _pool, Pool_worker_t* _self, Task_t* _task)
+{
+	if (_task->group) {
+		TaskGroup_t* group = _task->group;
+		_task->fn(_task->ctx, _task->begin, _task->end);
+		CT_FREE(_task);
+		atomic_fetch_sub_explicit(&group->pending, 1, memory_order_release);
+		return;
+	}
+
+	Pool_range(_pool, _self, _task->fn, _task->ctx, _task->begin, _task->end, _task->grain);
+	atomic_store_explicit(&_task->done, true, memory_order_release);
+}
+
+static const bool Pool_has_work(Pool_t* restrict _pool)
+{
+	for ( u32 idx = 0; idx <= _pool->n_threads; ++idx ) {
+		Deque_t* deque = &_pool->workers[idx].deque;
+		if (atomic_load(&deque->top) < atomic_load(&deque->bottom)) return true;
+	}
+	return false;
+}
+
+static void* Pool_worker(void* _arg)
+{
+	Pool_worker_t* self = (Pool_worker_t*)_arg;
+	Pool_t* pool = self->pool;
+	POOL_SELF = self;
+
+	u32 idle = 0;
+	for ( ;; ) {
+		Task_t* task = Deque_take(&self->deque);
+		if (!task) task = Pool_steal(pool, self);
+		if (task) {
+			Pool_execute(pool, self, task);
+			idle = 0;
+			continue;
+		}
+
+		if (atomic_load_explicit(&pool->stop, memory_order_acquire)) break;
+		if (++idle < POOL_SPIN) {
+			sched_yield();
+			continue;
+		}
+
+		// no wakeup can be missed: a pusher publishes bottom, fences, then reads sleepers, and a
+		// sleeper bumps sleepers before rechecking every deque, so one of them sees the other,
+		// and a pusher that sees a sleeper signals under the lock it only drops inside the wait
+		pthread_mutex_lock(&pool->lock);
+		atomic_fetch_add(&pool->sleepers, 1);
+		if (!atomic_load(&pool->stop) && !Pool_has_work(pool))
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		atomic_fetch_sub(&pool->sleepers, 1);
+		pthread_mutex_unlock(&pool->lock);
+		idle = 0;
+	}
+
+	return NULL;
+}
+
+static Pool_worker_t* Pool_enter(Pool_t* restrict _pool, Pool_worker_t** _prev)
+/*
+ | Returns the deque the calling thread owns in _pool
+ | Threads outside the pool share the last slot, one at a time
+*/
+{
+	*_prev = POOL_SELF;
+	if (POOL_SELF && POOL_SELF->pool == _pool) return POOL_SELF;
+
+	pthread_mutex_lock(&_pool->external);
+	POOL_SELF = &_pool->workers[_pool->n_threads];
+	return POOL_SELF;
+}
+
+static void Pool_leave(Pool_t* restrict _pool, Pool_worker_t* _prev)
+{
+	if (POOL_SELF == _prev) return;
+	POOL_SELF = _prev;
+	pthread_mutex_unlock(&_pool->external);
+}
+
+CT_API Pool_t* Pool_create(const register u32 _n_threads)
+/*
+ | Creates a pool with _n_threads workers, the thread calling parallel_for or wait also takes part
+ | so a pool of 0 workers runs everything on the caller
+*/
+{
+	Pool_t* pool = (Pool_t*)CT_CALLOC(1, sizeof(Pool_t));
+	if (!pool) return NULL;
+
+	const u32 n = (_n_threads > POOL_MAX_THREADS) ? POOL_MAX_THREADS : _n_threads;
+	// the deques need cache line alignment, which CT_MALLOC can not give, so this stays on aligned_alloc
+	pool->workers = (Pool_worker_t*)aligned_alloc(CACHE_LINE, (n + 1) * sizeof(Pool_worker_t));
+	if (!pool->workers) {
+		CT_FREE(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->external, NULL);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	atomic_init(&pool->sleepers, 0);
+	atomic_init(&pool->stop, false);
+
+	for ( u32 idx = 0; idx <= n; ++idx ) {
+		Pool_worker_t* worker = &pool->workers[idx];
+		atomic_init(&worker->deque.top, 0);
+		atomic_init(&worker->deque.bottom, 0);
+		worker->pool = pool;
+		worker->rng = 0x9E3779B97F4A7C15UL * (idx + 1);
+	}
+
+	pool->n_threads = n;
+	for ( u32 idx = 0; idx < n; ++idx ) {
+		if (pthread_create(&pool->workers[idx].thread, NULL, Pool_worker, &pool->workers[idx]) == 0) continue;
+
+		atomic_store(&pool->stop, true);
+		for ( u32 started = 0; started < idx; ++started )
+			pthread_join(pool->workers[started].thread, NULL);
+		free(pool->workers);
+		CT_FREE(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+static Pool_t* POOL_GLOBAL = NULL;
+static pthread_once_t POOL_GLOBAL_ONCE = PTHREAD_ONCE_INIT;
+
+static void Pool_global_init(void)
+{
+	const long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	POOL_GLOBAL = Pool_create((n_cpus > 1) ? (u32)(n_cpus - 1) : 0);
+}
+
+CT_API Pool_t* Pool_global(void)
+/*
+ | Returns the lazily created process wide pool, sized to one worker per online cpu minus the caller
+*/
+{
+	pthread_once(&POOL_GLOBAL_ONCE, Pool_global_init);
+	return POOL_GLOBAL;
+}
+
+CT_API u32 Pool_threads(const Pool_t* restrict _pool)
+/*
+ | Returns the number of threads that take part in a parallel_for, including the caller
+*/
+{
+	return _pool ? _pool->n_threads + 1 : 1;
+}
+
+CT_API const bool Pool_parallel_for(Pool_t* restrict _pool, const u64 _begin, const u64 _end, const u64 _grain, Pool_fn _fn, void* _ctx)
+/*
+ | Runs _fn over [_begin, _end) split into ranges of at most _grain indices, every range
+ | starts on a multiple of _grain past _begin
+ | Blocks until every range has been processed, may be called from inside a task
+*/
+{
+	if (!_fn || _begin > _end) return false;
+	if (_begin == _end) return true;
+	const u64 grain = _grain ? _grain : 1;
+
+	if (!_pool || _pool->n_threads == 0 || (_end - _begin) <= grain) {
+		for ( u64 begin = _begin; begin < _end; begin += grain )
+			_fn(_ctx, begin, (begin + grain < _end) ? begin + grain : _end);
+		return true;
+	}
+
+	Pool_worker_t* prev;
+	Pool_worker_t* self = Pool_enter(_pool, &prev);
+	Pool_range(_pool, self, _fn, _ctx, _begin, _end, grain);
+	Pool_leave(_pool, prev);
+
+	return true;
+}
+
+CT_API const bool Pool_group(TaskGroup_t* restrict _group)
+/*
+ | Initializes an empty task group
+*/
+{
+	if (!_group) return false;
+	atomic_init(&_group->pending, 0);
+	return true;
+}
+
+CT_API const bool Pool_spawn(Pool_t* restrict _pool, TaskGroup_t* restrict _group, Pool_fn _fn, void* _ctx, const u64 _begin, const u64 _end)
+/*
+ | Queues _fn(_ctx, _begin, _end) as part of _group, runs it inline if the deque is full
+*/
+{
+	if (!_pool || !_group || !_fn) return false;
+
+	Task_t* task = (Task_t*)CT_MALLOC(sizeof(Task_t));
+	if (!task) {
+		_fn(_ctx, _begin, _end);
+		return true;
+	}
+	task->fn = _fn;
+	task->ctx = _ctx;
+	task->begin = _begin;
+	task->end = _end;
+	task->grain = 0;
+	task->group = _group;
+	atomic_fetch_add_explicit(&_group->pending, 1, memory_order_relaxed);
+
+	Pool_worker_t* prev;
+	Pool_worker_t* self = Pool_enter(_pool, &prev);
+	if (Deque_push(&self->deque, task)) Pool_notify(_pool);
+	else Pool_execute(_pool, self, task);
+	Pool_leave(_pool, prev);
+
+	return true;
+}
+
+CT_API const bool Pool_wait(Pool_t* restrict _pool, TaskGroup_t* restrict _group)
+/*
+ | Blocks until every task spawned into _group has finished, running queued tasks meanwhile
+*/
+{
+	if (!_pool || !_group) return false;
+
+	Pool_worker_t* prev;
+	Pool_worker_t* self = Pool_enter(_pool, &prev);
+	while ( atomic_load_explicit(&_group->pending, memory_order_acquire) > 0 ) {
+		Task_t* task = Deque_take(&self->deque);
+		if (!task) task = Pool_steal(_pool, self);
+
+		if (task) Pool_execute(_pool, self, task);
+		else sched_yield();
+	}
+	Pool_leave(_pool, prev);
+
+	return true;
+}
+
+CT_API const bool Pool_destroy(Pool_t* restrict _pool)
+/*
+ | Stops the workers once their deques are drained and frees the pool
+*/
+{
+	if (!_pool) return false;
+
+	atomic_store_explicit(&_pool->stop, true, memory_order_release);
+	pthread_mutex_lock(&_pool->lock);
+	pthread_cond_broadcast(&_pool->wake);
+	pthread_mutex_unlock(&_pool->lock);
+
+	for ( u32 idx = 0; idx < _pool->n_threads; ++idx )
+		pthread_join(_pool->workers[idx].thread, NULL);
+
+	pthread_mutex_destroy(&_pool->external);
+	pthread_mutex_destroy(&_pool->lock);
+	pthread_cond_destroy(&_pool->wake);
+	free(_pool->workers);
+	CT_FREE(_pool);
+
+	return true;
+}
+
+const static struct Pool_funcs Pool = {
+	Pool_create,
+	Pool_global,
+	Pool_threads,
+	Pool_parallel_for,
+	Pool_group,
+	Pool_spawn,
+	Pool_wait,
+	Pool_destroy,
+};
+
+#endif // End _CT_STL_THREAD_POOL_H
@@ -17,4 +17,18 @@ typedef float d32;
 typedef double d64;
 typedef long double d128;
 
+/*
+ | Linkage of every public entry point behind the dispatch tables
+ | By default they are ordinary external functions reached through the dispatch tables, which
+ | limits a program to one translation unit including the headers
+ | -DCT_STATIC_DISPATCH turns them into static inline functions so calls through the const
+ | tables fold into direct, inlinable calls and any number of translation units can include them,
+ | each then keeps its own file scope state such as the global pool and instrumentation sites
+*/
+#ifdef CT_STATIC_DISPATCH
+#define CT_API static inline
+#else
+#define CT_API
+#endif
+
 #endif // End _CT_STL_TYPES_H
@@ -0,0 +1,345 @@
+#ifndef _CT_STL_UTF8_H
+#define _CT_STL_UTF8_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_X86 1
+#endif
+
+#include "string.h"
+#include "optional.h"
+#include "types.h"
+
+/*
+ | UTF-8 on top of the byte strings
+ | Everything here takes a (ptr, len) span so it works the same on String_t and SS_t data
+ | Pure ASCII input is detected 16 bytes at a time and keeps the plain byte level paths
+*/
+
+struct UTF8_funcs {
+	const bool	(*is_ascii)(const char* restrict, const u64);
+	const bool	(*validate)(const char* restrict, const u64);
+	u8			(*cp_len)(const char);
+	u64			(*count)(const char* restrict, const u64);
+	Optional(u32) (*next)(const char* restrict, const u64, u64* restrict);
+	const bool	(*rev)(String_t*);
+};
+
+CT_API u8 UTF8_cp_len(const char _lead)
+/*
+ | Returns the length of the sequence started by _lead, 0 for continuation or invalid bytes
+*/
+{
+	const u8 lead = (u8)_lead;
+	if (lead < 0x80) return 1;
+	if (lead < 0xC2) return 0;
+	if (lead < 0xE0) return 2;
+	if (lead < 0xF0) return 3;
+	if (lead < 0xF5) return 4;
+	return 0;
+}
+
+CT_API const bool UTF8_is_ascii(const char* restrict _str, const u64 _str_len)
+/*
+ | Returns true when no byte has its high bit set
+*/
+{
+	u64 idx = 0;
+#ifdef __SSE2__
+	__m128i acc = _mm_setzero_si128();
+	for ( ; idx + 16 <= _str_len; idx += 16 )
+		acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i*)(_str + idx)));
+	if (_mm_movemask_epi8(acc)) return false;
+#endif
+	u64 acc64 = 0;
+	for ( ; idx + 8 <= _str_len; idx += 8 ) {
+		u64 chunk;
+		memcpy(&chunk, _str + idx, sizeof(u64));
+		acc64 |= chunk;
+	}
+	for ( ; idx < _str_len; ++idx )
+		acc64 |= (u8)_str[idx];
+
+	return (acc64 & 0x8080808080808080) == 0;
+}
+
+static u64 utf8_validate_scalar(const u8* restrict _str, const u64 _str_len)
+/*
+ | Returns the index of the first malformed byte, or _str_len when the span is valid
+ | Follows table 3-7 of the Unicode standard, which rules out overlongs and surrogates
+*/
+{
+	u64 idx = 0;
+	while ( idx < _str_len ) {
+		const u8 lead = _str[idx];
+		if (lead < 0x80) {
+			++idx;
+			continue;
+		}
+
+		const u8 len = UTF8_cp_len((char)lead);
+		if (len == 0 || idx + len > _str_len) return idx;
+
+		const u8 second = _str[idx + 1];
+		u8 low = 0x80;
+		u8 high = 0xBF;
+		if (lead == 0xE0) low = 0xA0;
+		else if (lead == 0xED) high = 0x9F;
+		else if (lead == 0xF0) low = 0x90;
+		else if (lead == 0xF4) high = 0x8F;
+		if (second < low || second > high) return idx;
+
+		for ( u8 cont = 2; cont < len; ++cont )
+			if ((_str[idx + cont] & 0xC0) != 0x80) return idx;
+
+		idx += len;
+	}
+	return _str_len;
+}
+
+#ifdef UTF8_X86
+/*
+ | Lookup based validation, three 16 entry tables indexed by the nibbles of each byte and
+ | the byte before it flag every error class, a valid pair ANDs down to zero
+ | Source: John Keiser, Daniel Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"
+ |         https://arxiv.org/abs/2010.03090
+*/
+#define UTF8_TOO_SHORT		(1 << 0)
+#define UTF8_TOO_LONG		(1 << 1)
+#define UTF8_OVERLONG_3		(1 << 2)
+#define UTF8_TOO_LARGE		(1 << 3)
+#define UTF8_SURROGATE		(1 << 4)
+#define UTF8_OVERLONG_2		(1 << 5)
+#define UTF8_TOO_LARGE_1000	(1 << 6)
+#define UTF8_OVERLONG_4		(1 << 6)
+#define UTF8_TWO_CONTS		(1 << 7)
+#define UTF8_CARRY			(UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+__attribute__((target("ssse3")))
+static inline __m128i utf8_nibble_hi(const __m128i _vec)
+{
+	return _mm_and_si128(_mm_srli_epi16(_vec, 4), _mm_set1_epi8(0x0F));
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i utf8_check_block(const __m128i _input, const __m128i _prev_input)
+{
+	const __m128i byte_1_high_table = _mm_setr_epi8(
+		UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+		UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+		UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+		UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+		UTF8_TOO_SHORT,
+		UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+		UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+	);
+	const __m128i byte_1_low_table = _mm_setr_epi8(
+		UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+		UTF8_CARRY | UTF8_OVERLONG_2,
+		UTF8_CARRY,
+		UTF8_CARRY,
+		UTF8_CARRY | UTF8_TOO_LARGE,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+	);
+	const __m128i byte_2_high_table = _mm_setr_epi8(
+		UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+		UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+		UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+	);
+
+	const __m128i prev1 = _mm_alignr_epi8(_input, _prev_input, 15);
+	const __m128i special = _mm_and_si128(
+		_mm_and_si128(
+			_mm_shuffle_epi8(byte_1_high_table, utf8_nibble_hi(prev1)),
+			_mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(prev1, _mm_set1_epi8(0x0F)))),
+		_mm_shuffle_epi8(byte_2_high_table, utf8_nibble_hi(_input)));
+
+	// the third and fourth bytes of a sequence must be continuations, the tables only see pairs
+	const __m128i prev2 = _mm_alignr_epi8(_input, _prev_input, 14);
+	const __m128i prev3 = _mm_alignr_epi8(_input, _prev_input, 13);
+	const __m128i is_third = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80)));
+	const __m128i is_fourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80)));
+	const __m128i must_23 = _mm_and_si128(_mm_or_si128(is_third, is_fourth), _mm_set1_epi8((char)0x80));
+
+	return _mm_xor_si128(must_23, special);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i utf8_is_incomplete(const __m128i _input)
+/*
+ | Flags a block whose last three bytes start a sequence that runs into the next block
+*/
+{
+	const __m128i max = _mm_setr_epi8(
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		(char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+	return _mm_subs_epu8(_input, max);
+}
+
+__attribute__((target("ssse3")))
+static const bool utf8_validate_ssse3(const char* restrict _str, const u64 _str_len)
+{
+	__m128i error = _mm_setzero_si128();
+	__m128i prev_input = _mm_setzero_si128();
+	__m128i prev_incomplete = _mm_setzero_si128();
+
+	u64 idx = 0;
+	for ( ; idx + 16 <= _str_len; idx += 16 ) {
+		const __m128i input = _mm_loadu_si128((const __m128i*)(_str + idx));
+		if (_mm_movemask_epi8(input) == 0) {
+			error = _mm_or_si128(error, prev_incomplete);
+			prev_incomplete = _mm_setzero_si128();
+		} else {
+			error = _mm_or_si128(error, utf8_check_block(input, prev_input));
+			prev_incomplete = utf8_is_incomplete(input);
+		}
+		prev_input = input;
+	}
+
+	if (idx < _str_len) {
+		// zero padding is ASCII, so a sequence cut off by the end still reports as too short
+		char tail[16] = { 0 };
+		memcpy(tail, _str + idx, _str_len - idx);
+		const __m128i input = _mm_loadu_si128((const __m128i*)tail);
+		error = _mm_or_si128(error, utf8_check_block(input, prev_input));
+		prev_incomplete = _mm_setzero_si128();
+	}
+	error = _mm_or_si128(error, prev_incomplete);
+
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+}
+#endif
+
+CT_API const bool UTF8_validate(const char* restrict _str, const u64 _str_len)
+/*
+ | Returns true when the span is well formed UTF-8
+ | Uses the SSSE3 lookup validator when the cpu has it and the scalar decoder otherwise
+*/
+{
+	if (!_str) return false;
+#ifdef UTF8_X86
+	// libgcc fills in the cpu model from a constructor before main, so this is a plain load that
+	// every thread can make, unlike a lazily set static
+	if (__builtin_cpu_supports("ssse3")) return utf8_validate_ssse3(_str, _str_len);
+#endif
+	return utf8_validate_scalar((const u8*)_str, _str_len) == _str_len;
+}
+
+CT_API u64 UTF8_count(const char* restrict _str, const u64 _str_len)
+/*
+ | Returns the number of code points, which is the number of bytes that are not continuations
+*/
+{
+	u64 count = 0;
+	u64 idx = 0;
+#ifdef __SSE2__
+	// continuation bytes are 0x80..0xBF, which are the signed values below -64
+	const __m128i threshold = _mm_set1_epi8(-65);
+	for ( ; idx + 16 <= _str_len; idx += 16 ) {
+		const __m128i input = _mm_loadu_si128((const __m128i*)(_str + idx));
+		count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpgt_epi8(input, threshold)));
+	}
+#endif
+	for ( ; idx < _str_len; ++idx )
+		count += ((_str[idx] & 0xC0) != 0x80);
+
+	return count;
+}
+
+CT_API Optional(u32) UTF8_next(const char* restrict _str, const u64 _str_len, u64* restrict _idx)
+/*
+ | Decodes the code point at *_idx and moves *_idx past it
+ | Returns None at the end of the span or on a malformed sequence, in which case *_idx
+ | still moves forward by one byte so iteration can resume
+*/
+{
+	if (!_str || !_idx || *_idx >= _str_len) return None(u32);
+
+	const u8* str = (const u8*)_str + *_idx;
+	const u8 len = UTF8_cp_len((char)str[0]);
+	if (len == 1) {
+		++*_idx;
+		return Some(u32, str[0]);
+	}
+	if (len == 0 || *_idx + len > _str_len || utf8_validate_scalar(str, len) != len) {
+		++*_idx;
+		return None(u32);
+	}
+
+	u32 cp = str[0] & (0x7F >> len);
+	for ( u8 cont = 1; cont < len; ++cont )
+		cp = (cp << 6) | (str[cont] & 0x3F);
+	*_idx += len;
+
+	return Some(u32, cp);
+}
+
+static void utf8_rev_bytes(char* _begin, char* _end)
+{
+	while ( _begin < --_end ) {
+		const char tmp = *_begin;
+		*_begin++ = *_end;
+		*_end = tmp;
+	}
+}
+
+CT_API const bool UTF8_rev(String_t* _string)
+/*
+ | Reverses the string by code point in place
+ | Reverses all bytes, then flips each multi byte sequence back into order, ASCII strings
+ | stop after the first step
+*/
+{
+	if (!_string) return false;
+	const bool ascii = UTF8_is_ascii(_string->data, _string->len);
+	if (!ascii && !UTF8_validate(_string->data, _string->len)) return false;
+	if (!String_make_unique(_string)) return false;
+
+	utf8_rev_bytes(_string->data, _string->data + _string->len);
+	if (ascii) return true;
+
+	// a reversed sequence reads as its continuation bytes followed by its lead
+	char* curr = _string->data;
+	char* end = _string->data + _string->len;
+	while ( curr < end ) {
+		if ((*curr & 0xC0) != 0x80) {
+			++curr;
+			continue;
+		}
+		char* lead = curr;
+		while ( (*lead & 0xC0) == 0x80 ) ++lead;
+		utf8_rev_bytes(curr, lead + 1);
+		curr = lead + 1;
+	}
+
+	return true;
+}
+
+const static struct UTF8_funcs UTF8 = {
+	UTF8_is_ascii,
+	UTF8_validate,
+	UTF8_cp_len,
+	UTF8_count,
+	UTF8_next,
+	UTF8_rev,
+};
+
+#endif // End _CT_STL_UTF8_H